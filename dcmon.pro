@@ -1,6 +1,6 @@
 TEMPLATE = app
 TARGET = dcmon
-QT = core widgets
+QT = core widgets network
 MOC_DIR = .obj
 OBJECTS_DIR = .obj
 
@@ -8,11 +8,11 @@ OBJECTS_DIR = .obj
   CONFIG += debug
 }
 
-HEADERS += src/dclog.h   src/dcps.h   src/dclogview.h   src/dclogtab.h   src/dctoolbar.h   src/treelogmodel.h
-SOURCES += src/dclog.cpp src/dcps.cpp src/dclogview.cpp src/dclogtab.cpp src/dctoolbar.cpp src/treelogmodel.cpp
+HEADERS += src/dclog.h   src/dcps.h   src/dclogview.h   src/dclogtab.h   src/dctoolbar.h   src/treelogmodel.h   src/logstore.h src/logspill.h src/logsearch.h src/logindex.h src/logmatcher.h
+SOURCES += src/dclog.cpp src/dcps.cpp src/dclogview.cpp src/dclogtab.cpp src/dctoolbar.cpp src/treelogmodel.cpp src/logstore.cpp src/logspill.cpp src/logsearch.cpp src/logindex.cpp src/logmatcher.cpp
 
-HEADERS += src/dcmonwindow.h   src/dcmonconfig.h   src/fileutil.h
-SOURCES += src/dcmonwindow.cpp src/dcmonconfig.cpp src/fileutil.cpp src/main.cpp
+HEADERS += src/dcmonwindow.h   src/dcmonconfig.h   src/fileutil.h   src/guiprofiler.h   src/logparser.h   src/dockerlogstream.h   src/logentry.h   src/logrules.h
+SOURCES += src/dcmonwindow.cpp src/dcmonconfig.cpp src/fileutil.cpp src/guiprofiler.cpp src/logparser.cpp src/dockerlogstream.cpp src/logrules.cpp src/main.cpp
 
 !isEmpty(USE_LUA) {
   CONFIG += link_pkgconfig
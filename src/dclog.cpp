@@ -1,41 +1,43 @@
 #include "dclog.h"
 #include "dcmonconfig.h"
+#include "guiprofiler.h"
+#include "logparser.h"
+#include "dockerlogstream.h"
 #include <QRegularExpression>
+#include <QMutexLocker>
 #include <QtDebug>
+#include <cstring>
 
+// How long `docker-compose logs --help` may take before --since is assumed to be unsupported
+#define SINCE_PROBE_TIMEOUT 5000
+
+// Fallback for prefixes that appTimestampLength() declines to handle
 static QRegularExpression timestampRE("^\\s*(?:\\[?\\d{4}-\\d{2}-\\d{2}[T ]\\d{2}:\\d{2}(?::\\d{2}(?:[.,]\\d+)?)? ?(?:Z|UTC)?]?\\s?)+");
 
-static QString stripColor(QString msg) {
-  int s = msg.length();
-  for (int i = 0; i < s - 2; i++) {
-    if (msg[i] != char(27) || msg[i + 1] != '[') {
-      continue;
-    }
-    for (int j = i + 2; j < s; j++) {
-      QChar ch = msg[j];
-      if (ch == 'm') {
-        msg.replace(i, j - i + 1, "");
-        i -= 1;
-        s = msg.length();
-        break;
-      } else if (!ch.isDigit() && ch != ';') {
-        msg.replace(i, 1, "<ESC>");
-        s += 4;
-        i += 4;
-        break;
-      }
-    }
-    continue;
-  }
-  return msg;
-}
+static const char* const syntheticMessages[] = {
+  "GET /api/health?id=%1 200 0.4ms",
+  "\x1b[32mINFO\x1b[0m request %1 handled in 12ms",
+  "2021-06-01 12:00:00,123 \x1b[33mWARN\x1b[0m slow query on request %1",
+  "[2021-06-01T12:00:00Z] worker heartbeat %1",
+  "\x1b[1;31mERROR\x1b[0m unhandled exception in request %1",
+};
 
-DcLog::DcLog(QObject* parent) : QObject(parent), shutDown(false), paused(false)
+DcLog::DcLog(QObject* parent)
+: QObject(parent), process(this), synthetic(this), syntheticCount(0), dropTimer(this), sinceSupport(-1), shutDown(false), paused(false),
+  useEngine(CONFIG->engineApi && CONFIG->syntheticLoad == 0 && DockerLogStream::isAvailable())
 {
   process.setProcessChannelMode(QProcess::MergedChannels);
   QObject::connect(&process, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
   QObject::connect(&process, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(relaunch()));
-  start(100);
+  synthetic.setInterval(20);
+  QObject::connect(&synthetic, SIGNAL(timeout()), this, SLOT(generateSynthetic()));
+  dropTimer.setInterval(1000);
+  QObject::connect(&dropTimer, SIGNAL(timeout()), this, SLOT(reportDropped()));
+  QObject::connect(CONFIG, SIGNAL(configChanged()), this, SLOT(reloadRateLimits()));
+  rateClock.start();
+  // Deferred so that the process is created on whichever thread DcLog is moved to
+  QMetaObject::invokeMethod(this, "start", Qt::QueuedConnection, Q_ARG(int, 100));
+  qRegisterMetaType<LogBatch>("LogBatch");
 }
 
 void DcLog::pause() {
@@ -51,16 +53,89 @@ void DcLog::relaunch() {
 
 void DcLog::start(int tail)
 {
+  if (useEngine) {
+    paused = false;
+    for (DockerLogStream* stream : streams) {
+      if (!stream->isActive()) {
+        startStream(stream, tail);
+      }
+    }
+    return;
+  }
   if (process.state() != QProcess::NotRunning) {
     return;
   }
   paused = false;
-  process.start("docker-compose", QStringList() << "-f" << CONFIG->dcFile << "logs" << "--no-color" << "--follow" << QString("--tail=%1").arg(tail) << "--timestamps");
+  if (CONFIG->syntheticLoad > 0) {
+    if (!synthetic.isActive()) {
+      syntheticClock.start();
+      syntheticCount = 0;
+      synthetic.start();
+    }
+    return;
+  }
+  if (sinceSupport < 0) {
+    probeSince();
+  }
+  QStringList args = QStringList() << "-f" << CONFIG->dcFile << "logs" << "--no-color" << "--follow" << "--timestamps";
+  if (!cursors.isEmpty() && sinceSupport > 0) {
+    // One process serves every container, so resume from the oldest cursor.
+    // Lines older than a container's own cursor are dropped in processMessage.
+    qint64 since = cursors.begin()->nsecs;
+    for (ResumeCursor& cursor : cursors) {
+      since = qMin(since, cursor.nsecs);
+    }
+    args << "--since=" + QString::fromLatin1(formatSince(since));
+  }
+  for (ResumeCursor& cursor : cursors) {
+    cursor.skip = cursor.count;
+  }
+  // Even with --since, a quiet container's old cursor would otherwise make
+  // every busy container send everything it logged since then
+  args << QString("--tail=%1").arg(tail);
+  process.start("docker-compose", args);
+}
+
+void DcLog::probeSince()
+{
+  // docker-compose 1.x does not accept --since; ask once rather than guessing
+  // from the version. Waiting for the answer would hold up ingest, so until it
+  // arrives, or if docker-compose doesn't answer in time, restarts use --tail.
+  sinceSupport = 0;
+  QProcess* help = new QProcess(this);
+  QObject::connect(help, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(sinceProbeFinished(int,QProcess::ExitStatus)));
+  QObject::connect(help, &QProcess::errorOccurred, help, [help](QProcess::ProcessError error) {
+    if (error == QProcess::FailedToStart) {
+      help->deleteLater();
+    }
+  });
+  help->start("docker-compose", QStringList() << "logs" << "--help");
+  QTimer::singleShot(SINCE_PROBE_TIMEOUT, help, SLOT(kill()));
+}
+
+void DcLog::sinceProbeFinished(int, QProcess::ExitStatus status)
+{
+  QProcess* help = qobject_cast<QProcess*>(sender());
+  if (!help) {
+    return;
+  }
+  sinceSupport = (status == QProcess::NormalExit && help->readAllStandardOutput().contains("--since")) ? 1 : 0;
+  help->deleteLater();
+}
+
+QByteArray DcLog::formatSince(qint64 nsecs)
+{
+  // The Docker API and CLI both accept fractional Unix timestamps
+  return QByteArray::number(nsecs / 1000000000) + "." + QByteArray::number(nsecs % 1000000000).rightJustified(9, '0');
 }
 
 void DcLog::terminate()
 {
   shutDown = true;
+  synthetic.stop();
+  for (DockerLogStream* stream : streams) {
+    stream->abort();
+  }
   if (process.state() != QProcess::NotRunning) {
     process.terminate();
     if (!process.waitForFinished()) {
@@ -70,70 +145,456 @@ void DcLog::terminate()
   }
 }
 
+void DcLog::setContainers(const QStringList& containers)
+{
+  if (!useEngine) {
+    return;
+  }
+  for (auto iter = streams.begin(); iter != streams.end(); ) {
+    if (containers.contains(iter.key())) {
+      ++iter;
+    } else {
+      iter.value()->deleteLater();
+      iter = streams.erase(iter);
+    }
+  }
+  for (const QString& container : containers) {
+    if (streams.contains(container)) {
+      continue;
+    }
+    DockerLogStream* stream = new DockerLogStream(container, this);
+    QObject::connect(stream, SIGNAL(received(QString,int,QByteArray)), this, SLOT(onStreamReceived(QString,int,QByteArray)));
+    QObject::connect(stream, SIGNAL(error(QString,QString)), this, SLOT(onStreamError(QString,QString)));
+    QObject::connect(stream, SIGNAL(finished(QString)), this, SLOT(onStreamFinished(QString)));
+    streams[container] = stream;
+    if (!shutDown && !paused) {
+      startStream(stream, 100);
+    }
+  }
+}
+
+void DcLog::statusChanged(const QString& container, const QString& status)
+{
+  statuses[container] = status;
+  DockerLogStream* stream = streams.value(container);
+  if (stream && status == "running" && !stream->isActive() && !shutDown && !paused) {
+    startStream(stream, 1000);
+  }
+}
+
+void DcLog::startStream(DockerLogStream* stream, int tail)
+{
+  // Resume from whichever of stdout and stderr is further behind; the other
+  // one's repeated lines are dropped by its own cursor
+  qint64 since = -1;
+  for (int index : { int(DockerLogStream::Stdout), int(DockerLogStream::Stderr) }) {
+    auto cursor = cursors.find(qMakePair(stream->container(), index));
+    if (cursor != cursors.end()) {
+      cursor->skip = cursor->count;
+      since = since < 0 ? cursor->nsecs : qMin(since, cursor->nsecs);
+    }
+  }
+  if (since < 0) {
+    stream->start("tail=" + QByteArray::number(tail));
+  } else {
+    stream->start("since=" + formatSince(since));
+  }
+}
+
+void DcLog::onStreamReceived(const QString& container, int stream, const QByteArray& lines)
+{
+  GuiProfileScope profile;
+  const char* data = lines.constData();
+  int length = lines.size();
+  int pos = 0;
+  int count = 0;
+  QMutexLocker locker(&CONFIG->lock);
+  while (pos < length) {
+    const char* eol = static_cast<const char*>(std::memchr(data + pos, '\n', length - pos));
+    int lineLength = eol ? eol - (data + pos) + 1 : length - pos;
+    ComposeLine parsed;
+    if (!parseTimestampedLine(data + pos, lineLength, &parsed)) {
+      parsed.timestamp = nullptr;
+      parsed.timestampLength = 0;
+      parsed.message = data + pos;
+      parsed.messageLength = lineLength;
+    }
+    processMessage(container, stream, parsed);
+    pos += lineLength;
+    ++count;
+  }
+  applyBatchFilters();
+  locker.unlock();
+  flushBatch();
+  if (GuiProfiler::instance()) {
+    GuiProfiler::instance()->addLines(count);
+  }
+}
+
+void DcLog::onStreamError(const QString& container, const QString& message)
+{
+  batch << LogEntry{ QDateTime::currentMSecsSinceEpoch(), container, message };
+  flushBatch();
+}
+
+void DcLog::onStreamFinished(const QString& container)
+{
+  // A stream also ends when the container stops; it is restarted by statusChanged().
+  // If the container is still believed to be running, try again shortly.
+  DockerLogStream* stream = streams.value(container);
+  if (!stream || statuses.value(container) != "running") {
+    return;
+  }
+  QTimer::singleShot(1000, stream, [this, stream]{
+    if (!stream->isActive() && !shutDown && !paused && statuses.value(stream->container()) == "running") {
+      startStream(stream, 1000);
+    }
+  });
+}
+
 void DcLog::onReadyRead()
 {
+  GuiProfileScope profile;
+  bool doRestart = false;
+  buffer += process.readAll();
+  QMutexLocker locker(&CONFIG->lock);
+  int used = processLines(buffer.constData(), buffer.size(), &doRestart);
+  applyBatchFilters();
+  locker.unlock();
+  flushBatch();
+  buffer.remove(0, used);
+  if (doRestart) {
+    process.terminate();
+  }
+}
+
+void DcLog::generateSynthetic()
+{
+  GuiProfileScope profile;
+  qint64 target = syntheticClock.elapsed() * CONFIG->syntheticLoad / 1000;
+  QByteArray timestamp = QDateTime::currentDateTimeUtc().toString("yyyy-MM-dd'T'hh:mm:ss.zzz'000000Z'").toLatin1();
+  QByteArray chunk;
+  for (qint64 seq = syntheticCount; seq < target; seq++) {
+    QByteArray prefix = "synthetic_" + QByteArray::number(seq % 4 + 1) + "  | " + timestamp + " ";
+    int kind = seq % (sizeof(syntheticMessages) / sizeof(syntheticMessages[0]));
+    chunk += prefix + QByteArray(syntheticMessages[kind]).replace("%1", QByteArray::number(seq)) + "\n";
+    if (seq % 50 == 0) {
+      chunk += prefix + "    at Worker.run(worker.js:" + QByteArray::number(seq % 97) + ")\n";
+      chunk += prefix + "    at process._tickCallback(internal/process/next_tick.js:68:7)\n";
+    }
+  }
+  syntheticCount = target;
   bool doRestart = false;
-  while (process.canReadLine()) {
-    QString line = process.readLine();
-    int pipePos = line.indexOf('|');
-    if (pipePos < 0) {
+  QMutexLocker locker(&CONFIG->lock);
+  processLines(chunk.constData(), chunk.size(), &doRestart);
+  applyBatchFilters();
+  locker.unlock();
+  flushBatch();
+}
+
+void DcLog::flushBatch()
+{
+  if (batch.isEmpty()) {
+    return;
+  }
+  emit logBatch(batch);
+  // The receiver holds a shared copy, so start a fresh vector rather than detaching this one
+  batch = LogBatch();
+}
+
+bool DcLog::admitLine(const QString& container, int bytes)
+{
+  auto iter = rates.find(container);
+  if (iter == rates.end()) {
+    iter = rates.insert(container, RateState());
+    iter->limit = CONFIG->rateLimit(container);
+  }
+  RateState& rate = *iter;
+  if (!rate.limit.isEnabled()) {
+    return true;
+  }
+
+  qint64 now = rateClock.elapsed();
+  if (rate.refilled < 0) {
+    rate.lineCredit = rate.limit.lines;
+    rate.byteCredit = rate.limit.bytes;
+  } else if (now > rate.refilled) {
+    double seconds = (now - rate.refilled) / 1000.0;
+    rate.lineCredit = qMin<double>(rate.limit.lines, rate.lineCredit + rate.limit.lines * seconds);
+    rate.byteCredit = qMin<double>(rate.limit.bytes, rate.byteCredit + rate.limit.bytes * seconds);
+  }
+  rate.refilled = now;
+
+  // A single line longer than the byte budget is allowed to go into debt
+  // rather than being blocked forever.
+  if ((rate.limit.lines <= 0 || rate.lineCredit >= 1) && (rate.limit.bytes <= 0 || rate.byteCredit > 0)) {
+    rate.lineCredit -= 1;
+    rate.byteCredit -= bytes;
+    rate.overBudget = 0;
+    return true;
+  }
+
+  if (rate.limit.sample > 0 && rate.overBudget++ % rate.limit.sample == 0) {
+    ++rate.sampled;
+    return true;
+  }
+  ++rate.pending;
+  ++rate.dropped;
+  if (!dropTimer.isActive()) {
+    dropTimer.start();
+  }
+  return false;
+}
+
+void DcLog::reportDropped()
+{
+  // At most one marker per container per second, however hard it is flooding
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  bool anyPending = false;
+  for (auto iter = rates.begin(); iter != rates.end(); ++iter) {
+    if (iter->pending == 0) {
       continue;
     }
-    QString container = line.left(pipePos).trimmed();
-    int zPos = line.indexOf("Z ", pipePos + 2);
-    QDateTime timestamp;
-    if (zPos < 0) {
-      timestamp = QDateTime::currentDateTime();
-      zPos = pipePos;
-    } else {
-      QString timeString = line.mid(pipePos + 2, 30);
-      timestamp = QDateTime::fromString(timeString, Qt::ISODateWithMs);
+    anyPending = true;
+    batch << LogEntry{ now, iter.key(), tr("[dcmon] %n line(s) dropped by the rate limit", "", int(iter->pending)) };
+    iter->pending = 0;
+    emit linesDropped(iter.key(), iter->dropped, iter->sampled);
+  }
+  flushBatch();
+  if (!anyPending) {
+    dropTimer.stop();
+  }
+}
+
+void DcLog::reloadRateLimits()
+{
+  QMutexLocker locker(&CONFIG->lock);
+  for (auto iter = rates.begin(); iter != rates.end(); ++iter) {
+    iter->limit = CONFIG->rateLimit(iter.key());
+  }
+}
+
+int DcLog::processLines(const char* data, int length, bool* doRestart)
+{
+  int pos = 0;
+  int count = 0;
+  while (pos < length) {
+    const char* eol = static_cast<const char*>(std::memchr(data + pos, '\n', length - pos));
+    if (!eol) {
+      break;
     }
-    QString message = line.mid(zPos + 2);
-    if (message.contains("Error grabbing logs: unexpected EOF")) {
-      doRestart = true;
-      continue;
+    int lineLength = eol - (data + pos) + 1;
+    if (processLine(data + pos, lineLength)) {
+      *doRestart = true;
     }
-    if (CONFIG->hiddenContainers.contains(container)) {
-      continue;
+    pos += lineLength;
+    ++count;
+  }
+  if (GuiProfiler::instance()) {
+    GuiProfiler::instance()->addLines(count);
+  }
+  return pos;
+}
+
+const QString& DcLog::containerName(const char* name, int length)
+{
+  auto iter = containerNames.find(QByteArray::fromRawData(name, length));
+  if (iter == containerNames.end()) {
+    iter = containerNames.insert(QByteArray(name, length), QString::fromUtf8(name, length));
+  }
+  return *iter;
+}
+
+bool DcLog::processLine(const char* line, int length)
+{
+  ComposeLine parsed;
+  if (!parseComposeLine(line, length, &parsed)) {
+    return false;
+  }
+  if (QByteArray::fromRawData(parsed.message, parsed.messageLength).contains("Error grabbing logs: unexpected EOF")) {
+    return true;
+  }
+  processMessage(containerName(parsed.container, parsed.containerLength), DockerLogStream::Stdout, parsed);
+  return false;
+}
+
+bool DcLog::advanceCursor(const QString& container, int stream, qint64 nsecs)
+{
+  ResumeCursor& cursor = cursors[qMakePair(container, stream)];
+  if (nsecs > cursor.nsecs) {
+    cursor.nsecs = nsecs;
+    cursor.count = 1;
+    cursor.skip = 0;
+    return true;
+  } else if (nsecs < cursor.nsecs) {
+    return false;
+  } else if (cursor.skip > 0) {
+    --cursor.skip;
+    return false;
+  }
+  ++cursor.count;
+  return true;
+}
+
+void DcLog::processMessage(const QString& container, int stream, const ComposeLine& parsed)
+{
+  qint64 timestamp;
+  qint64 nsecs;
+  if (!parsed.timestamp) {
+    timestamp = QDateTime::currentMSecsSinceEpoch();
+  } else if (parseDockerTimestamp(parsed.timestamp, parsed.timestampLength, &nsecs)) {
+    if (!advanceCursor(container, stream, nsecs)) {
+      // Already seen before the stream was restarted
+      return;
     }
-    message = stripColor(message);
-    while (message.length() > 0 && message[message.length() - 1].isSpace()) {
-      message.chop(1);
-    }
-    message = message.remove(timestampRE);
-    if (!message.isEmpty()) {
-      LuaFunction filter = CONFIG->logFilter(container);
-      if (filter.isValid()) {
-        try {
-          QVariant filtered = LuaFunction::firstResult(filter({ message }));
-          if (!filtered.isValid()) {
-            continue;
-          } else if (filtered.canConvert<QByteArray>()) {
-            message = QString::fromUtf8(filtered.toByteArray());
-          }
-        } catch (LuaException& e) {
-          emit logMessage(timestamp, container, tr("Error in filter: %1").arg(QString::fromUtf8(e.what())));
-        }
+    timestamp = nsecs / 1000000;
+  } else {
+    QDateTime dt = QDateTime::fromString(QString::fromLatin1(parsed.timestamp, parsed.timestampLength), Qt::ISODateWithMs);
+    timestamp = dt.isValid() ? dt.toMSecsSinceEpoch() : LogEntry::NoTimestamp;
+  }
+  if (CONFIG->hiddenContainers.contains(container)) {
+    return;
+  }
+  if (!admitLine(container, parsed.messageLength)) {
+    return;
+  }
+  if (scratch.size() < size_t(parsed.messageLength) * 5) {
+    scratch.resize(parsed.messageLength * 5);
+  }
+  int messageLength = stripColor(parsed.message, parsed.messageLength, scratch.data());
+  messageLength = trimmedLength(scratch.data(), messageLength);
+  if (messageLength == 0) {
+    return;
+  }
+  // This is the only copy of the message text made while parsing.
+  QString message;
+  int prefixLength = appTimestampLength(scratch.data(), messageLength);
+  if (prefixLength >= 0) {
+    message = QString::fromUtf8(scratch.data() + prefixLength, messageLength - prefixLength);
+  } else {
+    message = QString::fromUtf8(scratch.data(), messageLength);
+    QRegularExpressionMatch match = timestampRE.match(message);
+    if (match.hasMatch()) {
+      message.remove(0, match.capturedLength());
+    }
+  }
+  if (message.isEmpty()) {
+    return;
+  }
+  // Native rules are cheap enough to run ahead of any Lua filter
+  const LogRules* rules = CONFIG->rules(container);
+  if (rules && !rules->apply(&message)) {
+    return;
+  }
+  bool fromStderr = stream == DockerLogStream::Stderr;
+  if (CONFIG->logBatchFilter(container).isValid()) {
+    // Filtered, and then passed to the views, once the whole burst has been read
+    addLine(LogEntry{ timestamp, container, message, fromStderr }, BatchFilterLine);
+    return;
+  }
+  LuaFunction filter = CONFIG->logFilter(container);
+  if (filter.isValid()) {
+    try {
+      QVariant filtered = LuaFunction::firstResult(filter({ message }));
+      if (!filtered.isValid()) {
+        return;
+      } else if (filtered.canConvert<QByteArray>()) {
+        message = QString::fromUtf8(filtered.toByteArray());
       }
-      emit logMessage(timestamp, container, message);
-
-      for (const QString& view : CONFIG->filterViews.keys()) {
-        LuaFunction filter = CONFIG->filterViews[view];
-        try {
-          QVariant filtered = LuaFunction::firstResult(filter({ container, message }));
-          if (!filtered.isValid()) {
-            continue;
-          } else if (filtered.canConvert<QByteArray>()) {
-            emit logMessage(timestamp, view, QString::fromUtf8(filtered.toByteArray()));
-          }
-        } catch (LuaException& e) {
-          emit logMessage(timestamp, view, tr("Error in view: %1").arg(QString::fromUtf8(e.what())));
+    } catch (LuaException& e) {
+      addLine(LogEntry{ timestamp, container, tr("Error in filter: %1").arg(QString::fromUtf8(e.what())) }, NoticeLine);
+    }
+  }
+  addLine(LogEntry{ timestamp, container, message, fromStderr }, ViewLine);
+}
+
+void DcLog::addLine(const LogEntry& entry, LineKind kind)
+{
+  if (kind == BatchFilterLine || !deferred.isEmpty()) {
+    deferred << entry;
+    deferredKinds << kind;
+    return;
+  }
+  batch << entry;
+  if (kind == ViewLine) {
+    applyViews(entry);
+  }
+}
+
+void DcLog::applyViews(const LogEntry& entry)
+{
+  for (const QString& view : CONFIG->filterViews.keys()) {
+    LuaFunction filter = CONFIG->filterViews[view];
+    try {
+      QVariant filtered = LuaFunction::firstResult(filter({ entry.container, entry.message }));
+      if (!filtered.isValid()) {
+        continue;
+      } else if (filtered.canConvert<QByteArray>()) {
+        batch << LogEntry{ entry.timestamp, view, QString::fromUtf8(filtered.toByteArray()), entry.fromStderr };
+      }
+    } catch (LuaException& e) {
+      batch << LogEntry{ entry.timestamp, view, tr("Error in view: %1").arg(QString::fromUtf8(e.what())) };
+    }
+  }
+}
+
+void DcLog::applyBatchFilters()
+{
+  if (deferred.isEmpty()) {
+    return;
+  }
+  QVector<bool> keep(deferred.size(), true);
+  // Errors go out just ahead of the first line of the call that failed
+  QHash<int, QString> errors;
+#ifdef D_USE_LUA
+  // One filter_batch call per container per burst, each getting that container's lines in order
+  QHash<QString, QVector<int>> groups;
+  for (int i = 0; i < deferred.size(); i++) {
+    if (deferredKinds[i] == BatchFilterLine) {
+      groups[deferred[i].container] << i;
+    }
+  }
+  for (auto group = groups.begin(); group != groups.end(); ++group) {
+    const QVector<int>& indexes = *group;
+    QStringList lines;
+    lines.reserve(indexes.size());
+    for (int index : indexes) {
+      lines << deferred[index].message;
+    }
+    try {
+      QVariant results = LuaFunction::firstResult(CONFIG->logBatchFilter(group.key())({ lines }));
+      if (results.userType() != qMetaTypeId<LuaTable>()) {
+        throw LuaException("filter_batch must return a table");
+      }
+      LuaTable table = results.value<LuaTable>();
+      for (int i = 0; i < indexes.size(); i++) {
+        QVariant filtered = table->get(i + 1);
+        if (!filtered.isValid()) {
+          keep[indexes[i]] = false;
+        } else if (filtered.canConvert<QByteArray>()) {
+          deferred[indexes[i]].message = QString::fromUtf8(filtered.toByteArray());
         }
       }
+    } catch (LuaException& e) {
+      // As with filter, the lines are kept unchanged after an error
+      errors[indexes[0]] = tr("Error in filter: %1").arg(QString::fromUtf8(e.what()));
     }
   }
-  if (doRestart) {
-    process.terminate();
+#endif
+  for (int i = 0; i < deferred.size(); i++) {
+    const LogEntry& entry = deferred[i];
+    auto error = errors.find(i);
+    if (error != errors.end()) {
+      batch << LogEntry{ entry.timestamp, entry.container, *error };
+    }
+    if (!keep[i]) {
+      continue;
+    }
+    batch << entry;
+    if (deferredKinds[i] != NoticeLine) {
+      applyViews(entry);
+    }
   }
+  deferred.clear();
+  deferredKinds.clear();
 }
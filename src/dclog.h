@@ -3,9 +3,19 @@
 
 #include <QProcess>
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QSet>
+#include <QHash>
+#include <QPair>
+#include <vector>
 #include "luavm.h"
+#include "logentry.h"
+class DockerLogStream;
+struct ComposeLine;
 
+// DcLog normally lives on its own thread (see DcmonWindow). Everything it
+// touches in DcmonConfig must be accessed while holding CONFIG->lock.
 class DcLog : public QObject {
 Q_OBJECT
 public:
@@ -15,18 +25,91 @@ public slots:
   void terminate();
   void pause();
   void start(int tail = 1000);
+  void setContainers(const QStringList& containers);
+  void statusChanged(const QString& container, const QString& status);
 
 signals:
-  void logMessage(const QDateTime& timestamp, const QString& container, const QString& message);
+  // Lines are delivered in batches, one per chunk of input read, so that the
+  // GUI thread handles one queued event per read instead of one per line.
+  void logBatch(const LogBatch& entries);
+  // Running totals for a container that has gone over its rate limit
+  void linesDropped(const QString& container, qint64 dropped, qint64 sampled);
 
 private slots:
   void relaunch();
   void onReadyRead();
+  void generateSynthetic();
+  void onStreamReceived(const QString& container, int stream, const QByteArray& lines);
+  void onStreamError(const QString& container, const QString& message);
+  void onStreamFinished(const QString& container);
+  void reportDropped();
+  void reloadRateLimits();
+  void sinceProbeFinished(int exitCode, QProcess::ExitStatus status);
 
 private:
+  int processLines(const char* data, int length, bool* doRestart);
+  bool processLine(const char* line, int length);
+  // stream is a DockerLogStream::Stream
+  void processMessage(const QString& container, int stream, const ComposeLine& parsed);
+  void startStream(DockerLogStream* stream, int tail);
+  bool advanceCursor(const QString& container, int stream, qint64 nsecs);
+  void probeSince();
+  void flushBatch();
+  bool admitLine(const QString& container, int bytes);
+  void applyViews(const LogEntry& entry);
+  void applyBatchFilters();
+
+  // How a line from a burst is finished: passed to the views as it is, run
+  // through filter_batch first, or neither, for dcmon's own error messages.
+  enum LineKind { ViewLine, BatchFilterLine, NoticeLine };
+  void addLine(const LogEntry& entry, LineKind kind);
+  static QByteArray formatSince(qint64 nsecs);
+
+  // Where to resume a container's log after a restart: the newest timestamp
+  // seen, how many lines carried that timestamp, and how many of those are
+  // still expected to be repeated by the restarted stream. Each of stdout and
+  // stderr has its own, because only lines within a stream arrive in order.
+  // docker-compose merges them, so its lines all count as stdout.
+  struct ResumeCursor {
+    qint64 nsecs = 0;
+    int count = 0;
+    int skip = 0;
+  };
+  const QString& containerName(const char* name, int length);
+
   QProcess process;
+  QByteArray buffer;
+  std::vector<char> scratch;
+  LogBatch batch;
+  // Once a line in a burst waits for filter_batch, the lines after it wait
+  // too, so that they all come out in the order they arrived
+  LogBatch deferred;
+  QVector<LineKind> deferredKinds;
+  QHash<QByteArray, QString> containerNames;
+  QTimer synthetic;
+  QElapsedTimer syntheticClock;
+  qint64 syntheticCount;
+  QHash<QString, DockerLogStream*> streams;
+  QHash<QString, QString> statuses;
+  QHash<QPair<QString, int>, ResumeCursor> cursors;
+
+  // Token buckets holding up to one second of a container's budget, plus
+  // how much has been thrown away since the last "lines dropped" marker.
+  struct RateState {
+    RateLimit limit;
+    double lineCredit = 0, byteCredit = 0;
+    qint64 refilled = -1;
+    qint64 overBudget = 0;
+    qint64 pending = 0;
+    qint64 dropped = 0;
+    qint64 sampled = 0;
+  };
+  QHash<QString, RateState> rates;
+  QElapsedTimer rateClock;
+  QTimer dropTimer;
+  int sinceSupport;
   LuaVM* lua;
-  bool shutDown, paused;
+  bool shutDown, paused, useEngine;
 };
 
 #endif
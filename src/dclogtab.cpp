@@ -1,4 +1,5 @@
 #include "dclogtab.h"
+#include "dcmonconfig.h"
 #include <QApplication>
 #include <QClipboard>
 #include <QScrollBar>
@@ -7,10 +8,13 @@
 #include <QLineEdit>
 #include <QVBoxLayout>
 #include <QSortFilterProxyModel>
-#include <QRegularExpression>
 #include <QMenu>
 #include <QKeyEvent>
 #include <QTimer>
+#include <QFontDatabase>
+#include <QThread>
+#include <QSet>
+#include <QHash>
 
 class LogTreeView : public QTreeView
 {
@@ -28,32 +32,77 @@ public:
 class FilterProxyModel : public QSortFilterProxyModel
 {
 public:
-  FilterProxyModel(QObject* parent = nullptr) : QSortFilterProxyModel(parent), enabled(false) {}
+  FilterProxyModel(QObject* parent = nullptr) : QSortFilterProxyModel(parent), enabled(false), snapshotStart(0), checkedEnd(0) {}
 
   bool enabled;
+  LogMatcher query;
+  // Lines in [snapshotStart, checkedEnd) have been or are being checked, and
+  // those found so far are in matches. The background search covers the
+  // snapshot, and lines appended after it are matched here as they arrive.
+  qint64 snapshotStart;
+  mutable qint64 checkedEnd;
+  mutable QSet<qint64> matches;
+  // Results for older lines, paged in from disk after the search started
+  mutable QHash<qint64, bool> olderMatches;
+
+  void setQuery(const LogMatcher& matcher, qint64 start, qint64 end) {
+    enabled = true;
+    query = matcher;
+    matches.clear();
+    olderMatches.clear();
+    snapshotStart = start;
+    checkedEnd = end;
+  }
+
+  void updateFilter() {
+    invalidateFilter();
+  }
+
+  bool canFetchMore(const QModelIndex& parent) const {
+    // Qt fetches more when the view reaches the bottom, but older top-level
+    // lines go at the top, so DcLogTab fetches those itself.
+    return parent.isValid() && QSortFilterProxyModel::canFetchMore(parent);
+  }
 
   bool filterAcceptsRow(int row, const QModelIndex& parent) const {
-    if (!enabled || !parent.isValid()) {
+    if (!enabled || parent.isValid()) {
+      // Nested lines are only visible if the line they belong to matched
       return true;
     }
-    QAbstractItemModel* model = sourceModel();
-    QModelIndex idx = model->index(row, 0, parent);
-    while (idx.isValid()) {
-      QString text = model->data(idx.siblingAtColumn(1), filterRole()).toString();
-      if (filterRegularExpression().match(text).hasMatch()) {
-        return true;
-      } else {
-        idx = idx.parent();
+    QModelIndex idx = sourceModel()->index(row, 0, parent);
+    qint64 id = idx.data(TreeLogModel::LineIdRole).toLongLong();
+    if (id >= snapshotStart && id < checkedEnd) {
+      return matches.contains(id);
+    } else if (id < snapshotStart) {
+      auto iter = olderMatches.constFind(id);
+      if (iter != olderMatches.constEnd()) {
+        return *iter;
       }
     }
-    return false;
+    // Each line is matched at most once per query, however often the
+    // filter is invalidated as results arrive
+    bool match = query.matches(idx.siblingAtColumn(1).data(Qt::DisplayRole).toString());
+    if (id < snapshotStart) {
+      olderMatches.insert(id, match);
+    } else {
+      // Rows are filtered in order, so a new line is only matched once
+      if (match) {
+        matches.insert(id);
+      }
+      checkedEnd = id + 1;
+    }
+    return match;
   }
 };
 
+// How long typing has to pause before a search starts, in milliseconds
+#define SEARCH_DELAY 150
 
-DcLogTab::DcLogTab(TreeLogModel* model, const QString& containerName, QWidget* parent)
-: QWidget(parent), container(containerName)
+DcLogTab::DcLogTab(const QString& containerName, QThread* searchThread, QWidget* parent)
+: QWidget(parent), container(containerName), model(new TreeLogModel(this)), searcher(new LogSearch), searchGeneration(0), lastCaseSensitive(false), lastRegexp(false), searchDone(false)
 {
+  model->setLogFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
   QVBoxLayout* layout = new QVBoxLayout(this);
   layout->setContentsMargins(0, 0, 0, 0);
   layout->setSpacing(1);
@@ -95,6 +144,35 @@ DcLogTab::DcLogTab(TreeLogModel* model, const QString& containerName, QWidget* p
   view->setHorizontalScrollMode(QTreeView::ScrollPerPixel);
   view->setModel(filterModel);
   layout->addWidget(view, 1);
+  QObject::connect(view->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(fetchOlder(int)));
+
+  searcher->moveToThread(searchThread);
+  QObject::connect(searcher, SIGNAL(matched(int, QVector<qint64>, bool)), this, SLOT(searchMatched(int, QVector<qint64>, bool)));
+
+  searchDelay.setSingleShot(true);
+  searchDelay.setInterval(SEARCH_DELAY);
+  QObject::connect(&searchDelay, SIGNAL(timeout()), this, SLOT(startSearch()));
+}
+
+DcLogTab::~DcLogTab()
+{
+  searcher->cancel();
+  searcher->deleteLater();
+}
+
+void DcLogTab::fetchOlder(int value)
+{
+  if (value > view->verticalScrollBar()->minimum() || !model->canFetchMore(QModelIndex())) {
+    return;
+  }
+  // Keep the line at the top of the view in place as lines appear above it
+  QPersistentModelIndex top(view->indexAt(QPoint(0, 0)));
+  int hpos = view->horizontalScrollBar()->value();
+  model->fetchMore(QModelIndex());
+  if (top.isValid()) {
+    view->scrollTo(top, QAbstractItemView::PositionAtTop);
+  }
+  view->horizontalScrollBar()->setValue(hpos);
 }
 
 void DcLogTab::showSearchMenu()
@@ -105,30 +183,95 @@ void DcLogTab::showSearchMenu()
 
 void DcLogTab::searchUpdated()
 {
-  QString text = search->text();
-  if (text.isEmpty()) {
+  if (search->text().isEmpty()) {
+    searchDelay.stop();
+    searcher->cancel();
+    searchDone = false;
     if (filterModel->enabled) {
       filterModel->enabled = false;
-      filterModel->invalidate();
+      filterModel->matches.clear();
+      filterModel->olderMatches.clear();
+      filterModel->updateFilter();
     }
     if (!search->hasFocus()) {
       search->hide();
     }
     return;
   }
-  filterModel->enabled = true;
-  if (!regexpAction->isChecked()) {
-    text = QRegularExpression::escape(text);
+  searchDelay.start();
+}
+
+void DcLogTab::startSearch()
+{
+  QString text = search->text();
+  if (text.isEmpty()) {
+    return;
+  }
+  bool caseSensitive = caseAction->isChecked();
+  bool regexp = regexpAction->isChecked();
+  LogMatcher matcher(text, regexp, caseSensitive);
+  if (!matcher.isValid()) {
+    return;
+  }
+  if (!filterModel->enabled) {
+    model->fetchAll();
   }
-  QRegularExpression re(text);
-  if (caseAction->isChecked()) {
-    re.setPatternOptions(QRegularExpression::UseUnicodePropertiesOption);
+  searchTimer.start();
+  // A narrower query can only match lines that the last one matched, so if
+  // that search finished, only its matches and newer lines need checking.
+  // Otherwise the index may be able to rule lines out.
+  QSet<qint64> candidates;
+  qint64 candidatesStart = 0, candidatesEnd = 0;
+  bool narrow = searchDone && refines(text, caseSensitive, regexp);
+  if (narrow) {
+    candidates.swap(filterModel->matches);
+    candidatesStart = filterModel->snapshotStart;
+    candidatesEnd = filterModel->checkedEnd;
   } else {
-    re.setPatternOptions(QRegularExpression::UseUnicodePropertiesOption | QRegularExpression::CaseInsensitiveOption);
+    narrow = model->indexCandidates(text, regexp, caseSensitive, &candidates, &candidatesStart, &candidatesEnd);
+  }
+  LogSnapshot snapshot = model->snapshot(narrow ? &candidates : nullptr, candidatesStart, candidatesEnd);
+  searchGeneration = searcher->restart();
+  searchDone = false;
+  lastQuery = text;
+  lastCaseSensitive = caseSensitive;
+  lastRegexp = regexp;
+  filterModel->setQuery(matcher, snapshot.start, snapshot.end);
+  filterModel->updateFilter();
+  QMetaObject::invokeMethod(searcher, "search", Qt::QueuedConnection,
+      Q_ARG(int, searchGeneration), Q_ARG(LogMatcher, matcher), Q_ARG(LogSnapshot, snapshot));
+}
+
+bool DcLogTab::refines(const QString& text, bool caseSensitive, bool regexp) const
+{
+  if (regexp != lastRegexp) {
+    return false;
+  } else if (regexp) {
+    // Turning case sensitivity on doesn't narrow a regular expression:
+    // [^e], (?!E) and backreferences can match more lines when it is on
+    return text == lastQuery && caseSensitive == lastCaseSensitive;
+  } else if (lastCaseSensitive && !caseSensitive) {
+    return false;
   }
-  if (re.isValid()) {
-    filterModel->setFilterRegularExpression(re);
+  return text.contains(lastQuery, lastCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+}
+
+void DcLogTab::searchMatched(int generation, const QVector<qint64>& ids, bool finished)
+{
+  if (generation != searchGeneration || !filterModel->enabled) {
+    return;
+  }
+  searchDone = finished;
+  if (finished && CONFIG->profile) {
+    qDebug("search: %d matches in %.1f ms", filterModel->matches.size() + ids.size(), searchTimer.nsecsElapsed() / 1000000.0);
+  }
+  if (ids.isEmpty()) {
+    return;
   }
+  for (qint64 id : ids) {
+    filterModel->matches.insert(id);
+  }
+  filterModel->updateFilter();
 }
 
 void DcLogTab::searchFinished()
@@ -140,13 +283,6 @@ void DcLogTab::searchFinished()
   }
 }
 
-void DcLogTab::setRootIndex(const QModelIndex& index)
-{
-  if (!view->rootIndex().isValid()) {
-    view->setRootIndex(filterModel->mapFromSource(index));
-  }
-}
-
 void DcLogTab::keyPressEvent(QKeyEvent* event)
 {
   if (event == QKeySequence::Find) {
@@ -251,6 +387,10 @@ void DcLogTab::setScrollPos(const QPoint& pos)
   QScrollBar* vs = view->verticalScrollBar();
   hs->setValue(pos.x());
   if (pos.y() < 0) {
+    // Following the tail, so only the newest lines need to stay fetched
+    if (!filterModel->enabled) {
+      model->unfetchOlder();
+    }
     QTimer::singleShot(0, vs, [vs]{ vs->triggerAction(QAbstractSlider::SliderToMaximum); });
   } else {
     vs->setValue(pos.y());
@@ -2,20 +2,27 @@
 #define D_DCLOGTAB_H
 
 #include <QWidget>
+#include <QTimer>
+#include <QElapsedTimer>
 #include "treelogmodel.h"
+#include "logentry.h"
+#include "logsearch.h"
 class QTreeView;
 class QLineEdit;
 class QMenu;
+class QThread;
 class FilterProxyModel;
 
 class DcLogTab : public QWidget {
 Q_OBJECT
 public:
-  DcLogTab(TreeLogModel* model, const QString& containerName, QWidget* parent);
+  // Searches run on searchThread, which is shared between the tabs.
+  DcLogTab(const QString& containerName, QThread* searchThread, QWidget* parent);
+  ~DcLogTab();
 
   const QString container;
-  QDateTime lastTimestamp;
-  QList<QPair<QDateTime, QString>> queue;
+  TreeLogModel* const model;
+  LogBatch queue;
 
   QPoint scrollPos() const;
   void setScrollPos(const QPoint& pos);
@@ -26,13 +33,15 @@ public slots:
   void copySelected();
   void searchUpdated();
   void searchFinished();
-  void setRootIndex(const QModelIndex& index);
 
 protected:
   void keyPressEvent(QKeyEvent* event);
 
 private slots:
   void showSearchMenu();
+  void fetchOlder(int value);
+  void startSearch();
+  void searchMatched(int generation, const QVector<qint64>& ids, bool finished);
 
 private:
   QLineEdit* search;
@@ -41,6 +50,15 @@ private:
   QAction* regexpAction;
   QTreeView* view;
   FilterProxyModel* filterModel;
+  LogSearch* searcher;
+  QTimer searchDelay;
+  QElapsedTimer searchTimer;
+  int searchGeneration;
+
+  // The last query searched for, and whether its search has finished
+  bool refines(const QString& text, bool caseSensitive, bool regexp) const;
+  QString lastQuery;
+  bool lastCaseSensitive, lastRegexp, searchDone;
 };
 
 #endif
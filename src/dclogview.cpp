@@ -1,6 +1,7 @@
 #include "dclogview.h"
 #include "dclogtab.h"
 #include "dcmonconfig.h"
+#include "guiprofiler.h"
 #include "luavm.h"
 #include <QApplication>
 #include <QTreeView>
@@ -10,13 +11,13 @@
 #include <QLineEdit>
 #include <QMenu>
 #include <QAction>
-#include <QFontDatabase>
 #include <QStyle>
 #include <QKeyEvent>
 #include <QClipboard>
+#include <QSettings>
 #include <algorithm>
 
-DcLogView::DcLogView(QWidget* parent) : QTabWidget(parent), lua(nullptr)
+DcLogView::DcLogView(QWidget* parent) : QTabWidget(parent), lastLog(nullptr), lua(nullptr)
 {
   setTabPosition(QTabWidget::South);
   QObject::connect(this, SIGNAL(currentChanged(int)), this, SLOT(tabActivated(int)));
@@ -25,14 +26,40 @@ DcLogView::DcLogView(QWidget* parent) : QTabWidget(parent), lua(nullptr)
   throttle.setInterval(100);
   QObject::connect(&throttle, SIGNAL(timeout()), this, SLOT(onTimer()));
 
-  model.setLogFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  QSettings settings;
+  settings.beginGroup("view");
+  _localTime = settings.value("localTime", false).toBool();
+  _showMilliseconds = settings.value("showMilliseconds", false).toBool();
+
+  searchThread.start();
 
   QObject::connect(CONFIG, SIGNAL(configChanged()), this, SLOT(configChanged()));
   configChanged();
 }
 
+DcLogView::~DcLogView()
+{
+  // The tabs stop their searches before the search thread goes away
+  blockSignals(true);
+  qDeleteAll(logs);
+  logs.clear();
+  searchThread.quit();
+  searchThread.wait();
+}
+
 void DcLogView::configChanged()
 {
+  for (DcLogTab* log : logs) {
+    log->model->setSpillEnabled(CONFIG->spill);
+    log->model->setInterning(CONFIG->intern(log->container));
+    log->model->setIndexEnabled(CONFIG->searchIndex(log->container));
+    log->model->setMaxBytes(CONFIG->maxBytes(log->container));
+  }
+  flushOldest();
+  for (const QString& name : names) {
+    updateToolTip(name);
+  }
+
   QStringList newViews = CONFIG->filterViews.keys();
   for (int i = names.length() - 1; i >= 0; --i) {
     QString name = names[i];
@@ -72,15 +99,22 @@ void DcLogView::destroyTab(int index)
 {
   removeTab(index);
   QString name = names.takeAt(index);
+  if (lastLog == logs[name]) {
+    lastLog = nullptr;
+  }
   logs[name]->deleteLater();
   logs.remove(name);
 }
 
 void DcLogView::addContainer(const QString& container, bool isFilter)
 {
-  model.addContainer(container);
-  DcLogTab* pane = new DcLogTab(&model, container, this);
-  pane->setRootIndex(model.rootForContainer(container));
+  DcLogTab* pane = new DcLogTab(container, &searchThread, this);
+  pane->model->setSpillEnabled(CONFIG->spill);
+  pane->model->setInterning(CONFIG->intern(container));
+  pane->model->setIndexEnabled(CONFIG->searchIndex(container));
+  pane->model->setMaxBytes(CONFIG->maxBytes(container));
+  pane->model->setLocalTime(_localTime);
+  pane->model->setShowMilliseconds(_showMilliseconds);
   logs[container] = pane;
   if (isFilter) {
     names.insert(0, container);
@@ -109,6 +143,38 @@ void DcLogView::statusChanged(const QString& container, const QString& status)
   }
 }
 
+void DcLogView::linesDropped(const QString& container, qint64 dropped, qint64 sampled)
+{
+  dropCounts[container] = qMakePair(dropped, sampled);
+  updateToolTip(container);
+}
+
+void DcLogView::updateToolTip(const QString& container)
+{
+  DcLogTab* log = logs.value(container);
+  if (!log) {
+    return;
+  }
+  QString tip = tr("Memory: %1").arg(locale().formattedDataSize(log->model->memoryUsage()));
+  if (log->model->interning()) {
+    tip += "\n" + tr("Repeated text shared: %1x").arg(log->model->dedupRatio(), 0, 'f', 1);
+  }
+  if (log->model->indexEnabled()) {
+    tip += "\n" + tr("Search index: %1").arg(locale().formattedDataSize(log->model->indexSize()));
+  }
+  if (log->model->spillSize()) {
+    tip += "\n" + tr("On disk: %1").arg(locale().formattedDataSize(log->model->spillSize()));
+  }
+  if (!log->model->spillError().isEmpty()) {
+    tip += "\n" + tr("Not kept on disk: %1").arg(log->model->spillError());
+  }
+  auto drops = dropCounts.find(container);
+  if (drops != dropCounts.end()) {
+    tip += "\n" + tr("Rate limit: %1 lines dropped, %2 lines sampled").arg(drops->first).arg(drops->second);
+  }
+  setTabToolTip(indexOf(log), tip);
+}
+
 void DcLogView::logMessage(const QString& container, const QString& message)
 {
   logMessage(QDateTime(), container, message);
@@ -116,34 +182,83 @@ void DcLogView::logMessage(const QString& container, const QString& message)
 
 void DcLogView::logMessage(const QDateTime& timestamp, const QString& container, const QString& message)
 {
-  if (!logs.contains(container)) {
-    addContainer(container);
+  GuiProfileScope profile;
+  enqueue(LogEntry{ timestamp.isValid() ? timestamp.toMSecsSinceEpoch() : LogEntry::NoTimestamp, container, message });
+  if (!throttle.isActive()) {
+    throttle.start();
   }
-  DcLogTab* log = logs[container];
-  if (!timestamp.isNull()) {
-    if (log->lastTimestamp > timestamp) {
-      // Old log message
-      return;
-    }
-    log->lastTimestamp = timestamp;
+}
+
+void DcLogView::logBatch(const LogBatch& entries)
+{
+  GuiProfileScope profile;
+  for (const LogEntry& entry : entries) {
+    enqueue(entry);
   }
-  log->queue << QPair<QDateTime, QString>(timestamp, message);
   if (!throttle.isActive()) {
     throttle.start();
   }
 }
 
+void DcLogView::enqueue(const LogEntry& entry)
+{
+  // Batches are usually long runs from the same container
+  if (!lastLog || lastLog->container != entry.container) {
+    if (!logs.contains(entry.container)) {
+      addContainer(entry.container);
+    }
+    lastLog = logs[entry.container];
+  }
+  lastLog->queue << entry;
+}
+
 void DcLogView::onTimer()
 {
+  GuiProfileScope profile;
+  // Only the tabs whose logs changed need their tooltips rebuilt
+  QSet<QString> changed;
   for (DcLogTab* log : logs) {
-    QPoint scrollPos = log->scrollPos();
-    while (!log->queue.isEmpty()) {
-      auto msg = log->queue.takeFirst();
-      model.logMessage(msg.first, log->container, msg.second);
+    if (log->queue.isEmpty()) {
+      continue;
     }
-    log->setRootIndex(model.rootForContainer(log->container));
+    changed << log->container;
+    QPoint scrollPos = log->scrollPos();
+    log->model->appendBatch(log->queue);
+    log->queue.clear();
+    log->model->flushOldest();
     log->setScrollPos(scrollPos);
   }
+  flushOldest(&changed);
+  for (const QString& name : changed) {
+    updateToolTip(name);
+  }
+}
+
+void DcLogView::flushOldest(QSet<QString>* flushed)
+{
+  // Once all of the logs together exceed the total budget, each gives up a
+  // share of the excess in proportion to its size.
+  qint64 limit = CONFIG->maxTotalBytes;
+  if (limit <= 0) {
+    return;
+  }
+  qint64 total = 0;
+  for (const DcLogTab* log : logs) {
+    total += log->model->byteSize();
+  }
+  if (total <= limit) {
+    return;
+  }
+  double excess = total - (limit - limit / 10);
+  for (DcLogTab* log : logs) {
+    qint64 share = qint64(excess * log->model->byteSize() / total);
+    if (share > 0) {
+      log->model->freeBytes(share);
+      if (flushed) {
+        *flushed << log->container;
+      }
+    }
+  }
 }
 
 void DcLogView::tabActivated(int index)
@@ -164,6 +279,38 @@ QString DcLogView::currentContainer() const
   return names[index];
 }
 
+bool DcLogView::localTime() const
+{
+  return _localTime;
+}
+
+void DcLogView::setLocalTime(bool on)
+{
+  _localTime = on;
+  QSettings settings;
+  settings.beginGroup("view");
+  settings.setValue("localTime", on);
+  for (DcLogTab* log : logs) {
+    log->model->setLocalTime(on);
+  }
+}
+
+bool DcLogView::showMilliseconds() const
+{
+  return _showMilliseconds;
+}
+
+void DcLogView::setShowMilliseconds(bool on)
+{
+  _showMilliseconds = on;
+  QSettings settings;
+  settings.beginGroup("view");
+  settings.setValue("showMilliseconds", on);
+  for (DcLogTab* log : logs) {
+    log->model->setShowMilliseconds(on);
+  }
+}
+
 void DcLogView::showEvent(QShowEvent* event)
 {
   QTabWidget::showEvent(event);
@@ -172,7 +319,10 @@ void DcLogView::showEvent(QShowEvent* event)
 
 void DcLogView::clearCurrent()
 {
-  model.clear(currentContainer());
+  DcLogTab* log = logs.value(currentContainer());
+  if (log) {
+    log->model->clear();
+  }
 }
 
 void DcLogView::keyPressEvent(QKeyEvent* event)
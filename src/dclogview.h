@@ -4,9 +4,11 @@
 #include <QTabWidget>
 #include <QDateTime>
 #include <QHash>
+#include <QSet>
 #include <QTimer>
 #include <QSignalMapper>
-#include "treelogmodel.h"
+#include <QThread>
+#include "logentry.h"
 class FilterProxyModel;
 class QTreeView;
 class QLineEdit;
@@ -17,8 +19,11 @@ class DcLogView : public QTabWidget {
 Q_OBJECT
 public:
   DcLogView(QWidget* parent = nullptr);
+  ~DcLogView();
 
   QString currentContainer() const;
+  bool localTime() const;
+  bool showMilliseconds() const;
 
 signals:
   void currentContainerChanged(const QString& name);
@@ -28,9 +33,13 @@ public slots:
   void addContainer(const QString& container, bool isFilter = false);
   void logMessage(const QDateTime& timestamp, const QString& container, const QString& message);
   void logMessage(const QString& container, const QString& message);
+  void logBatch(const LogBatch& entries);
   void statusChanged(const QString& container, const QString& status);
+  void linesDropped(const QString& container, qint64 dropped, qint64 sampled);
   void clearCurrent();
   void copySelected();
+  void setLocalTime(bool on);
+  void setShowMilliseconds(bool on);
 
 private slots:
   void destroyTab(int index);
@@ -44,11 +53,19 @@ protected:
   void copySelected(QTreeView* view);
 
 private:
+  void enqueue(const LogEntry& entry);
+  // Adds the containers whose logs were trimmed to `flushed`, if given
+  void flushOldest(QSet<QString>* flushed = nullptr);
+  void updateToolTip(const QString& container);
+
   QSignalMapper searchUpdatedMapper, searchFinishedMapper;
   QHash<QString, DcLogTab*> logs;
+  DcLogTab* lastLog;
+  bool _localTime, _showMilliseconds;
+  QHash<QString, QPair<qint64, qint64>> dropCounts;
   QStringList names, filterViews;
   QTimer throttle;
-  TreeLogModel model;
+  QThread searchThread;
   LuaVM* lua;
 };
 
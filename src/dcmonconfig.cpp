@@ -3,6 +3,7 @@
 #include "luavm.h"
 #include <QSettings>
 #include <QFileSystemWatcher>
+#include <QMutexLocker>
 
 template <typename T = std::runtime_error>
 static inline void throwString(const QString& what)
@@ -12,13 +13,125 @@ static inline void throwString(const QString& what)
 
 static DcmonConfig* DcmonConfig_instance = nullptr;
 
+// Parses a byte count with an optional K, M, or G suffix
+static qint64 parseSize(const QString& text, bool* ok)
+{
+  QString number = text.trimmed().toUpper();
+  qint64 scale = 1;
+  if (number.endsWith("K")) {
+    scale = 1LL << 10;
+  } else if (number.endsWith("M")) {
+    scale = 1LL << 20;
+  } else if (number.endsWith("G")) {
+    scale = 1LL << 30;
+  }
+  if (scale > 1) {
+    number.chop(1);
+  }
+  qint64 value = number.toLongLong(ok);
+  if (*ok && value < 0) {
+    *ok = false;
+  }
+  return value * scale;
+}
+
+#ifdef D_USE_LUA
+static RateLimit readRateLimit(const QVariant& value, const RateLimit& fallback)
+{
+  if (value.userType() != qMetaTypeId<LuaTable>()) {
+    return fallback;
+  }
+  // Fields that the table leaves out keep their fallback values
+  LuaTable table = value.value<LuaTable>();
+  RateLimit limit = fallback;
+  if (table->has("lines")) {
+    limit.lines = table->get("lines").toInt();
+  }
+  if (table->has("bytes")) {
+    limit.bytes = table->get("bytes").toLongLong();
+  }
+  if (table->has("sample")) {
+    limit.sample = table->get("sample").toInt();
+  }
+  return limit;
+}
+
+static qint64 readSize(const QVariant& value, qint64 fallback, const QString& what)
+{
+  if (!value.isValid()) {
+    return fallback;
+  }
+  bool ok = false;
+  qint64 size;
+  if (int(value.type()) == QMetaType::QByteArray) {
+    // Strings may use a suffix, such as "64M"
+    size = parseSize(QString::fromUtf8(value.toByteArray()), &ok);
+  } else {
+    size = value.toLongLong(&ok);
+    ok = ok && size >= 0;
+  }
+  if (!ok) {
+    throwString<LuaException>(DcmonConfig::tr("Invalid value for %1: %2").arg(what).arg(value.toString()));
+  }
+  return size;
+}
+
+static LogRules compileRules(const QString& container, const LuaTable& table)
+{
+  LogRules rules;
+  for (int i = 1; table->has(i); i++) {
+    LuaTable rule = table->get<LuaTable>(i);
+    if (!rule) {
+      throwString<LuaException>(DcmonConfig::tr("%1: rule %2 is not a table").arg(container).arg(i));
+    }
+    QString actionName = QString::fromUtf8(rule->get("action").toByteArray());
+    LogRules::Action action;
+    if (actionName == "drop") {
+      action = LogRules::Drop;
+    } else if (actionName == "keep") {
+      action = LogRules::Keep;
+    } else if (actionName == "replace") {
+      action = LogRules::Replace;
+    } else {
+      throwString<LuaException>(DcmonConfig::tr("%1: rule %2 has unknown action \"%3\"").arg(container).arg(i).arg(actionName));
+    }
+    LogRules::Match match = LogRules::Any;
+    QString pattern;
+    if (rule->has("literal")) {
+      match = LogRules::Literal;
+      pattern = QString::fromUtf8(rule->get("literal").toByteArray());
+    } else if (rule->has("prefix")) {
+      match = LogRules::Prefix;
+      pattern = QString::fromUtf8(rule->get("prefix").toByteArray());
+    } else if (rule->has("regex")) {
+      match = LogRules::Regex;
+      pattern = QString::fromUtf8(rule->get("regex").toByteArray());
+    }
+    if (match != LogRules::Any && pattern.isEmpty()) {
+      // An empty pattern would match every line, which is more likely a mistake than intended
+      throwString<LuaException>(DcmonConfig::tr("%1: rule %2 has an empty pattern").arg(container).arg(i));
+    }
+    try {
+      rules.addRule(action, match, pattern, QString::fromUtf8(rule->get("with").toByteArray()));
+    } catch (std::runtime_error& e) {
+      throwString<LuaException>(DcmonConfig::tr("%1: rule %2: %3").arg(container).arg(i).arg(QString::fromUtf8(e.what())));
+    }
+  }
+  return rules;
+}
+#endif
+
 DcmonConfig* DcmonConfig::instance()
 {
   return DcmonConfig_instance;
 }
 
 DcmonConfig::DcmonConfig()
-: QObject(nullptr)
+: QObject(nullptr), engineApi(true), syntheticLoad(0), ingestThread(true), profile(false), defaultMaxBytes(0), maxTotalBytes(0), spill(false), defaultIntern(false), defaultSearchIndex(false),
+#ifdef D_USE_LUA
+  argMaxBytes(0), argMaxTotalBytes(0), argSpill(false), argIntern(false), argSearchIndex(false),
+#endif
+  watcher(nullptr)
 {
   DcmonConfig_instance = this;
 }
@@ -36,6 +149,61 @@ void DcmonConfig::parseArgs(const QStringList& args)
       if (arg == "-p" || arg == "--prompt") {
         hasFilename = true;
         loadFileByExtension(promptForDockerCompose());
+      } else if (arg == "--compose-logs") {
+        engineApi = false;
+      } else if (arg.startsWith("--synthetic-load=")) {
+        bool ok = false;
+        syntheticLoad = arg.mid(17).toInt(&ok);
+        if (!ok || syntheticLoad < 0) {
+          throwString(tr("Invalid value: %1").arg(arg));
+        }
+      } else if (arg == "--no-ingest-thread") {
+        ingestThread = false;
+      } else if (arg == "--profile") {
+        profile = true;
+      } else if (arg.startsWith("--rate-limit=")) {
+        bool ok = false;
+        defaultRateLimit.lines = arg.mid(13).toInt(&ok);
+        if (!ok || defaultRateLimit.lines < 0) {
+          throwString(tr("Invalid value: %1").arg(arg));
+        }
+#ifdef D_USE_LUA
+        // Kept separately so that dcmon.lua's rate_limit can be reloaded on top of it
+        argRateLimit = defaultRateLimit;
+#endif
+      } else if (arg.startsWith("--max-bytes=")) {
+        bool ok = false;
+        defaultMaxBytes = parseSize(arg.mid(12), &ok);
+        if (!ok) {
+          throwString(tr("Invalid value: %1").arg(arg));
+        }
+#ifdef D_USE_LUA
+        argMaxBytes = defaultMaxBytes;
+#endif
+      } else if (arg.startsWith("--max-total-bytes=")) {
+        bool ok = false;
+        maxTotalBytes = parseSize(arg.mid(18), &ok);
+        if (!ok) {
+          throwString(tr("Invalid value: %1").arg(arg));
+        }
+#ifdef D_USE_LUA
+        argMaxTotalBytes = maxTotalBytes;
+#endif
+      } else if (arg == "--spill") {
+        spill = true;
+#ifdef D_USE_LUA
+        argSpill = true;
+#endif
+      } else if (arg == "--intern") {
+        defaultIntern = true;
+#ifdef D_USE_LUA
+        argIntern = true;
+#endif
+      } else if (arg == "--index") {
+        defaultSearchIndex = true;
+#ifdef D_USE_LUA
+        argSearchIndex = true;
+#endif
       } else {
         throwString(tr("Unknown flag: %1").arg(arg));
       }
@@ -77,6 +245,7 @@ void DcmonConfig::reloadConfig()
 {
 #ifdef D_USE_LUA
   if (!luaFile.isEmpty()) {
+    QMutexLocker locker(&lock);
     QString luaDcFile;
     if (!loadDcmonLua(&lua, luaFile, &luaDcFile)) {
       throw LuaException("could not read dcmon.lua file");
@@ -163,9 +332,22 @@ void DcmonConfig::initConfig()
   QObject::connect(watcher, SIGNAL(fileChanged(QString)), this, SIGNAL(filesUpdated()));
 
 #ifdef D_USE_LUA
+  QMutexLocker locker(&lock);
   LuaTable containers = lua.get("containers").value<LuaTable>();
   filters.clear();
+  batchFilters.clear();
+  logRules.clear();
+  rateLimits.clear();
+  containerMaxBytes.clear();
+  containerIntern.clear();
+  containerSearchIndex.clear();
   hiddenContainers.clear();
+  defaultRateLimit = readRateLimit(lua.get("rate_limit"), argRateLimit);
+  defaultMaxBytes = readSize(lua.get("max_bytes"), argMaxBytes, "max_bytes");
+  maxTotalBytes = readSize(lua.get("max_total_bytes"), argMaxTotalBytes, "max_total_bytes");
+  spill = argSpill || lua.get("spill").toBool();
+  defaultIntern = argIntern || lua.get("intern").toBool();
+  defaultSearchIndex = argSearchIndex || lua.get("index").toBool();
   for (const QVariant& keyVariant : containers->keys()) {
     QString key = keyVariant.toString();
     LuaTable container = containers->get<LuaTable>(key);
@@ -178,6 +360,33 @@ void DcmonConfig::initConfig()
     if (filter.userType() == qMetaTypeId<LuaFunction>()) {
       filters[key] = filter.value<LuaFunction>();
     }
+    QVariant rules = container->get("rules");
+    if (rules.userType() == qMetaTypeId<LuaTable>()) {
+      LogRules compiled = compileRules(key, rules.value<LuaTable>());
+      if (!compiled.isEmpty()) {
+        logRules[key] = compiled;
+      }
+    }
+    QVariant batchFilter = container->get("filter_batch");
+    if (batchFilter.userType() == qMetaTypeId<LuaFunction>()) {
+      batchFilters[key] = batchFilter.value<LuaFunction>();
+    }
+    QVariant maxBytes = container->get("max_bytes");
+    if (maxBytes.isValid()) {
+      containerMaxBytes[key] = readSize(maxBytes, defaultMaxBytes, key + ".max_bytes");
+    }
+    QVariant rateLimit = container->get("rate_limit");
+    if (rateLimit.isValid()) {
+      rateLimits[key] = readRateLimit(rateLimit, defaultRateLimit);
+    }
+    QVariant intern = container->get("intern");
+    if (intern.isValid()) {
+      containerIntern[key] = intern.toBool();
+    }
+    QVariant index = container->get("index");
+    if (index.isValid()) {
+      containerSearchIndex[key] = index.toBool();
+    }
   }
 
   LuaTable views = lua.get("views").value<LuaTable>();
@@ -189,6 +398,7 @@ void DcmonConfig::initConfig()
       filterViews[key] = view;
     }
   }
+  locker.unlock();
 #endif
 
   emit configChanged();
@@ -234,3 +444,68 @@ LuaFunction DcmonConfig::logFilter(const QString& container) const
 #endif
   return LuaFunction();
 }
+
+LuaFunction DcmonConfig::logBatchFilter(const QString& container) const
+{
+#ifdef D_USE_LUA
+  if (batchFilters.contains(container)) {
+    return batchFilters[container];
+  }
+#endif
+  return LuaFunction();
+}
+
+const LogRules* DcmonConfig::rules(const QString& container) const
+{
+#ifdef D_USE_LUA
+  auto iter = logRules.find(container);
+  if (iter != logRules.end()) {
+    return &*iter;
+  }
+#endif
+  return nullptr;
+}
+
+RateLimit DcmonConfig::rateLimit(const QString& container) const
+{
+#ifdef D_USE_LUA
+  auto iter = rateLimits.find(container);
+  if (iter != rateLimits.end()) {
+    return *iter;
+  }
+#endif
+  return defaultRateLimit;
+}
+
+qint64 DcmonConfig::maxBytes(const QString& container) const
+{
+#ifdef D_USE_LUA
+  auto iter = containerMaxBytes.find(container);
+  if (iter != containerMaxBytes.end()) {
+    return *iter;
+  }
+#endif
+  return defaultMaxBytes;
+}
+
+bool DcmonConfig::intern(const QString& container) const
+{
+#ifdef D_USE_LUA
+  auto iter = containerIntern.find(container);
+  if (iter != containerIntern.end()) {
+    return *iter;
+  }
+#endif
+  return defaultIntern;
+}
+
+bool DcmonConfig::searchIndex(const QString& container) const
+{
+#ifdef D_USE_LUA
+  auto iter = containerSearchIndex.find(container);
+  if (iter != containerSearchIndex.end()) {
+    return *iter;
+  }
+#endif
+  return defaultSearchIndex;
+}
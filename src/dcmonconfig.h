@@ -3,13 +3,26 @@
 
 #include <QObject>
 #include <QSet>
+#include <QMutex>
 #include <functional>
 #include "luavm.h"
+#include "logrules.h"
 class QFileSystemWatcher;
 
 #define MAX_FILE_HISTORY 4
 #define CONFIG DcmonConfig::instance()
 
+// Ingest budget for one container. A limit of 0 means unlimited. Once a
+// container is over budget, one line in every `sample` is still let through
+// (0 drops everything until the budget recovers).
+struct RateLimit {
+  int lines = 0;
+  qint64 bytes = 0;
+  int sample = 0;
+
+  inline bool isEnabled() const { return lines > 0 || bytes > 0; }
+};
+
 class DcmonConfig : public QObject {
 Q_OBJECT
 public:
@@ -24,9 +37,42 @@ public:
   QSet<QString> hiddenContainers;
   QHash<QString, LuaFunction> filterViews;
   LuaFunction logFilter(const QString& container) const;
+  LuaFunction logBatchFilter(const QString& container) const;
+  // Returns nullptr if the container has no rules. Valid while holding lock.
+  const LogRules* rules(const QString& container) const;
+  RateLimit rateLimit(const QString& container) const;
+  // Byte budget for a container's stored log, or 0 for no limit
+  qint64 maxBytes(const QString& container) const;
+  // Whether repeated lines in a container's stored log share their text
+  bool intern(const QString& container) const;
+  // Whether a container's stored log keeps a trigram index for searching
+  bool searchIndex(const QString& container) const;
 
   QString dcFile, luaFile;
 
+  // Read logs through the Docker Engine API instead of docker-compose
+  bool engineApi;
+
+  // Developer options for measuring ingest performance
+  int syntheticLoad;
+  bool ingestThread, profile;
+
+  // Applies to containers without their own rate_limit
+  RateLimit defaultRateLimit;
+
+  // Byte budgets for stored logs: per container unless overridden, and for
+  // all containers together. 0 means no limit.
+  qint64 defaultMaxBytes, maxTotalBytes;
+
+  // Keep evicted log lines in temporary files so that they can still be browsed
+  bool spill;
+
+  // Apply to containers without their own intern or index setting
+  bool defaultIntern, defaultSearchIndex;
+
+  // Guards the Lua state and the filter tables, which DcLog uses from its own thread.
+  QMutex lock;
+
 signals:
   void filesUpdated();
   void configChanged();
@@ -43,7 +89,15 @@ private:
 
 #ifdef D_USE_LUA
   LuaVM lua;
-  QHash<QString, LuaFunction> filters;
+  QHash<QString, LuaFunction> filters, batchFilters;
+  QHash<QString, LogRules> logRules;
+  QHash<QString, RateLimit> rateLimits;
+  RateLimit argRateLimit;
+  QHash<QString, qint64> containerMaxBytes;
+  qint64 argMaxBytes, argMaxTotalBytes;
+  bool argSpill;
+  QHash<QString, bool> containerIntern, containerSearchIndex;
+  bool argIntern, argSearchIndex;
 #endif
 
   QFileSystemWatcher* watcher;
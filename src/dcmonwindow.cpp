@@ -15,8 +15,9 @@
 #include <QMessageBox>
 #include <QDesktopServices>
 #include <QUrl>
+#include <QThread>
 
-DcmonWindow::DcmonWindow(QWidget* parent) : QMainWindow(parent)
+DcmonWindow::DcmonWindow(QWidget* parent) : QMainWindow(parent), logThread(nullptr)
 {
   setWindowIcon(style()->standardIcon(QStyle::SP_MediaPause));
   setWindowTitle(QString("dcmon - %1").arg(CONFIG->dcFile));
@@ -46,6 +47,8 @@ DcmonWindow::DcmonWindow(QWidget* parent) : QMainWindow(parent)
   ctr->addAction(tb->aRestartAll);
   ctr->addAction(tb->aStopAll);
 
+  QMenu* viewMenu = menu->addMenu(tr("&View"));
+
   QMenu* help = menu->addMenu(tr("&Help"));
   help->addAction(tr("Visit &Website"), this, SLOT(visitWebsite()));
   help->addSeparator();
@@ -73,6 +76,15 @@ DcmonWindow::DcmonWindow(QWidget* parent) : QMainWindow(parent)
 
   view = new DcLogView(this);
   layout->addWidget(view, 1);
+
+  QAction* localTime = viewMenu->addAction(tr("&Local Time"));
+  localTime->setCheckable(true);
+  localTime->setChecked(view->localTime());
+  QObject::connect(localTime, SIGNAL(toggled(bool)), view, SLOT(setLocalTime(bool)));
+  QAction* showMs = viewMenu->addAction(tr("Show &Milliseconds"));
+  showMs->setCheckable(true);
+  showMs->setChecked(view->showMilliseconds());
+  QObject::connect(showMs, SIGNAL(toggled(bool)), view, SLOT(setShowMilliseconds(bool)));
   QObject::connect(tb, SIGNAL(clearOne()), view, SLOT(clearCurrent()));
   QObject::connect(view, SIGNAL(currentContainerChanged(QString)), tb, SLOT(setCurrentContainer(QString)));
 
@@ -83,16 +95,37 @@ DcmonWindow::DcmonWindow(QWidget* parent) : QMainWindow(parent)
   QObject::connect(tb, SIGNAL(pollStatus()), ps, SLOT(poll()));
   QObject::connect(qApp, SIGNAL(aboutToQuit()), ps, SLOT(terminate()));
 
-  logger = new DcLog(this);
+  if (CONFIG->ingestThread) {
+    // Log parsing and filtering run off the GUI thread; only finished lines cross over.
+    logger = new DcLog();
+    logThread = new QThread(this);
+    logger->moveToThread(logThread);
+    QObject::connect(logThread, SIGNAL(finished()), logger, SLOT(deleteLater()));
+    logThread->start();
+  } else {
+    logger = new DcLog(this);
+  }
   QObject::connect(tb, SIGNAL(logMessage(QDateTime,QString,QString)), view, SLOT(logMessage(QDateTime,QString,QString)));
-  QObject::connect(logger, SIGNAL(logMessage(QDateTime,QString,QString)), view, SLOT(logMessage(QDateTime,QString,QString)));
-  QObject::connect(qApp, SIGNAL(aboutToQuit()), logger, SLOT(terminate()));
+  QObject::connect(logger, SIGNAL(logBatch(LogBatch)), view, SLOT(logBatch(LogBatch)));
+  QObject::connect(logger, SIGNAL(linesDropped(QString,qint64,qint64)), view, SLOT(linesDropped(QString,qint64,qint64)));
+  QObject::connect(qApp, SIGNAL(aboutToQuit()), logger, SLOT(terminate()), logThread ? Qt::BlockingQueuedConnection : Qt::AutoConnection);
   QObject::connect(ps, SIGNAL(allStopped()), logger, SLOT(pause()));
   QObject::connect(ps, SIGNAL(started()), logger, SLOT(start()));
+  QObject::connect(ps, SIGNAL(containerListChanged(QStringList)), logger, SLOT(setContainers(QStringList)));
+  QObject::connect(ps, SIGNAL(statusChanged(QString,QString)), logger, SLOT(statusChanged(QString,QString)));
+  QMetaObject::invokeMethod(logger, "setContainers", Qt::QueuedConnection, Q_ARG(QStringList, ps->containerList()));
 
   QObject::connect(CONFIG, SIGNAL(filesUpdated()), this, SLOT(filesUpdated()));
 }
 
+DcmonWindow::~DcmonWindow()
+{
+  if (logThread) {
+    logThread->quit();
+    logThread->wait();
+  }
+}
+
 void DcmonWindow::reloadConfig()
 {
   CONFIG->reloadConfig();
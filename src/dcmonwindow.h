@@ -7,11 +7,13 @@ class DcLogView;
 class DcPs;
 class DcLog;
 class QLabel;
+class QThread;
 
 class DcmonWindow : public QMainWindow {
 Q_OBJECT
 public:
   DcmonWindow(QWidget* parent = nullptr);
+  ~DcmonWindow();
 
 private slots:
   void reloadConfig();
@@ -29,6 +31,7 @@ private:
   DcLogView* view;
   DcPs* ps;
   DcLog* logger;
+  QThread* logThread;
   QLabel* notify;
 };
 #endif
@@ -0,0 +1,276 @@
+#include "dockerlogstream.h"
+#include <QFileInfo>
+#include <QUrl>
+#include <QtEndian>
+
+QString DockerLogStream::socketPath()
+{
+  QByteArray host = qgetenv("DOCKER_HOST");
+  if (host.isEmpty()) {
+    return "/var/run/docker.sock";
+  } else if (host.startsWith("unix://")) {
+    return QString::fromLocal8Bit(host.mid(7));
+  }
+  // TCP and SSH endpoints are not supported; callers fall back to docker-compose
+  return QString();
+}
+
+bool DockerLogStream::isAvailable()
+{
+  QString path = socketPath();
+  return !path.isEmpty() && QFileInfo::exists(path);
+}
+
+DockerLogStream::DockerLogStream(const QString& container, QObject* parent)
+: QObject(parent), socket(this), name(container), state(Idle), chunked(false), multiplexed(false), sniffed(false), chunkRemaining(-1)
+{
+  QObject::connect(&socket, SIGNAL(connected()), this, SLOT(onConnected()));
+  QObject::connect(&socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+  QObject::connect(&socket, SIGNAL(disconnected()), this, SLOT(onDisconnected()));
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+  QObject::connect(&socket, SIGNAL(errorOccurred(QLocalSocket::LocalSocketError)), this, SLOT(onError()));
+#else
+  QObject::connect(&socket, SIGNAL(error(QLocalSocket::LocalSocketError)), this, SLOT(onError()));
+#endif
+}
+
+QString DockerLogStream::container() const
+{
+  return name;
+}
+
+bool DockerLogStream::isActive() const
+{
+  return state != Idle && state != Done;
+}
+
+void DockerLogStream::start(const QByteArray& query)
+{
+  abort();
+  this->query = query;
+  state = Connecting;
+  socket.connectToServer(socketPath());
+}
+
+void DockerLogStream::abort()
+{
+  // Reset the state first so that signals emitted by abort() are ignored
+  state = Idle;
+  socket.abort();
+  buffer.clear();
+  payload.clear();
+  for (QByteArray& data : partial) {
+    data.clear();
+  }
+  chunked = false;
+  multiplexed = false;
+  sniffed = false;
+  chunkRemaining = -1;
+}
+
+void DockerLogStream::onConnected()
+{
+  state = ReadingHeaders;
+  QByteArray request = "GET /containers/" + QUrl::toPercentEncoding(name) +
+    "/logs?follow=1&stdout=1&stderr=1&timestamps=1&" + query + " HTTP/1.1\r\n"
+    "Host: docker\r\n"
+    "\r\n";
+  socket.write(request);
+}
+
+void DockerLogStream::onReadyRead()
+{
+  buffer += socket.readAll();
+  if (state == ReadingHeaders && !parseHeaders()) {
+    abort();
+    emit finished(name);
+    return;
+  }
+  if (state != ReadingBody) {
+    return;
+  }
+  bool more = decodeBody();
+  demultiplex();
+  if (!more) {
+    for (int i = Stdin; i <= Stderr; i++) {
+      emitLines(i, true);
+    }
+    state = Done;
+    socket.disconnectFromServer();
+    emit finished(name);
+  }
+}
+
+void DockerLogStream::onDisconnected()
+{
+  if (state == ReadingBody) {
+    // Without chunked encoding, the body ends when the connection closes
+    if (!chunked) {
+      decodeBody();
+    }
+    demultiplex();
+    for (int i = Stdin; i <= Stderr; i++) {
+      emitLines(i, true);
+    }
+  } else if (state == Idle || state == Done) {
+    return;
+  } else {
+    emit error(name, tr("Docker API connection closed unexpectedly"));
+  }
+  state = Done;
+  emit finished(name);
+}
+
+void DockerLogStream::onError()
+{
+  if (state == Idle || state == Done || socket.error() == QLocalSocket::PeerClosedError) {
+    return;
+  }
+  emit error(name, tr("Docker API connection failed: %1").arg(socket.errorString()));
+  state = Done;
+  socket.abort();
+  emit finished(name);
+}
+
+bool DockerLogStream::parseHeaders()
+{
+  int end = buffer.indexOf("\r\n\r\n");
+  if (end < 0) {
+    // Wait for more data
+    return true;
+  }
+  QList<QByteArray> lines = buffer.left(end).split('\n');
+  buffer.remove(0, end + 4);
+
+  QByteArray statusLine = lines.value(0).trimmed();
+  int code = statusLine.split(' ').value(1).toInt();
+  for (int i = 1; i < lines.size(); i++) {
+    int colon = lines[i].indexOf(':');
+    if (colon < 0) {
+      continue;
+    }
+    QByteArray key = lines[i].left(colon).trimmed().toLower();
+    QByteArray value = lines[i].mid(colon + 1).trimmed().toLower();
+    if (key == "transfer-encoding") {
+      chunked = value.contains("chunked");
+    } else if (key == "content-type" && value.contains("multiplexed-stream")) {
+      // API 1.42 and later say so explicitly; older versions are detected from the data
+      multiplexed = true;
+      sniffed = true;
+    }
+  }
+  if (code != 200) {
+    emit error(name, tr("Docker API error: %1").arg(QString::fromUtf8(statusLine)));
+    return false;
+  }
+  state = ReadingBody;
+  return true;
+}
+
+bool DockerLogStream::decodeBody()
+{
+  if (!chunked) {
+    payload += buffer;
+    buffer.clear();
+    return true;
+  }
+  // chunkRemaining is -1 while waiting for a chunk size line and -2 while
+  // waiting for the CRLF that follows the chunk data.
+  bool more = true;
+  int pos = 0;
+  while (more && pos < buffer.size()) {
+    if (chunkRemaining < 0) {
+      int eol = buffer.indexOf("\r\n", pos);
+      if (eol < 0) {
+        break;
+      }
+      if (chunkRemaining == -2) {
+        chunkRemaining = -1;
+      } else {
+        QByteArray sizeLine = buffer.mid(pos, eol - pos);
+        int extension = sizeLine.indexOf(';');
+        if (extension >= 0) {
+          sizeLine.truncate(extension);
+        }
+        bool ok = false;
+        chunkRemaining = sizeLine.trimmed().toLongLong(&ok, 16);
+        if (!ok || chunkRemaining == 0) {
+          // The zero-length chunk ends the body; trailers are ignored
+          more = false;
+        }
+      }
+      pos = eol + 2;
+      continue;
+    }
+    int count = qMin<qint64>(chunkRemaining, buffer.size() - pos);
+    payload.append(buffer.constData() + pos, count);
+    pos += count;
+    chunkRemaining -= count;
+    if (chunkRemaining == 0) {
+      chunkRemaining = -2;
+    }
+  }
+  buffer.remove(0, pos);
+  return more;
+}
+
+void DockerLogStream::demultiplex()
+{
+  if (payload.isEmpty()) {
+    return;
+  }
+  if (!sniffed) {
+    // A multiplexed stream starts with an 8-byte frame header: stream type, three
+    // zero bytes, and a big-endian length. TTY output starts with a timestamp.
+    const char* header = payload.constData();
+    if (uchar(header[0]) > Stderr) {
+      multiplexed = false;
+    } else if (payload.size() < 8) {
+      return;
+    } else {
+      multiplexed = header[1] == 0 && header[2] == 0 && header[3] == 0;
+    }
+    sniffed = true;
+  }
+  if (!multiplexed) {
+    partial[Stdout] += payload;
+    payload.clear();
+    emitLines(Stdout, false);
+    return;
+  }
+
+  bool touched[3] = { false, false, false };
+  int pos = 0;
+  while (payload.size() - pos >= 8) {
+    const uchar* header = reinterpret_cast<const uchar*>(payload.constData() + pos);
+    quint32 size = qFromBigEndian<quint32>(header + 4);
+    if (quint32(payload.size() - pos - 8) < size) {
+      break;
+    }
+    int stream = header[0] <= Stderr ? header[0] : int(Stdout);
+    partial[stream].append(payload.constData() + pos + 8, size);
+    touched[stream] = true;
+    pos += 8 + size;
+  }
+  payload.remove(0, pos);
+  for (int i = Stdin; i <= Stderr; i++) {
+    if (touched[i]) {
+      emitLines(i, false);
+    }
+  }
+}
+
+void DockerLogStream::emitLines(int stream, bool flush)
+{
+  QByteArray& data = partial[stream];
+  int last = flush ? data.size() - 1 : data.lastIndexOf('\n');
+  if (last < 0) {
+    return;
+  }
+  QByteArray lines = data.left(last + 1);
+  data.remove(0, last + 1);
+  if (!lines.endsWith('\n')) {
+    lines += '\n';
+  }
+  emit received(name, stream, lines);
+}
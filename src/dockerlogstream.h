@@ -0,0 +1,59 @@
+#ifndef D_DOCKERLOGSTREAM_H
+#define D_DOCKERLOGSTREAM_H
+
+#include <QLocalSocket>
+#include <QByteArray>
+
+// Follows the logs of one container through the Docker Engine API, speaking
+// HTTP/1.1 directly over the daemon's unix socket. The socket path is taken
+// from DOCKER_HOST (unix:// only) so that the stream can be pointed at a fake
+// server that replays recorded output.
+class DockerLogStream : public QObject {
+Q_OBJECT
+public:
+  enum Stream { Stdin = 0, Stdout = 1, Stderr = 2 };
+
+  static QString socketPath();
+  static bool isAvailable();
+
+  DockerLogStream(const QString& container, QObject* parent = nullptr);
+
+  QString container() const;
+  bool isActive() const;
+
+public slots:
+  // query is appended to the logs request, e.g. "tail=1000"
+  void start(const QByteArray& query);
+  void abort();
+
+signals:
+  // lines holds one or more complete lines, each terminated by '\n'
+  void received(const QString& container, int stream, const QByteArray& lines);
+  void error(const QString& container, const QString& message);
+  void finished(const QString& container);
+
+private slots:
+  void onConnected();
+  void onReadyRead();
+  void onDisconnected();
+  void onError();
+
+private:
+  enum State { Idle, Connecting, ReadingHeaders, ReadingBody, Done };
+
+  bool parseHeaders();
+  bool decodeBody();
+  void demultiplex();
+  void emitLines(int stream, bool flush);
+
+  QLocalSocket socket;
+  QString name;
+  QByteArray query;
+  State state;
+  QByteArray buffer, payload;
+  QByteArray partial[3];
+  bool chunked, multiplexed, sniffed;
+  qint64 chunkRemaining;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "guiprofiler.h"
+#include <QCoreApplication>
+#include <QThread>
+#include <QtDebug>
+
+static GuiProfiler* GuiProfiler_instance = nullptr;
+
+GuiProfiler* GuiProfiler::instance()
+{
+  return GuiProfiler_instance;
+}
+
+GuiProfiler::GuiProfiler(QObject* parent)
+: QObject(parent), guiNsecs(0), lines(0)
+{
+  GuiProfiler_instance = this;
+  timer.setInterval(5000);
+  QObject::connect(&timer, SIGNAL(timeout()), this, SLOT(report()));
+  timer.start();
+  wall.start();
+}
+
+GuiProfiler::~GuiProfiler()
+{
+  GuiProfiler_instance = nullptr;
+}
+
+void GuiProfiler::addGuiTime(qint64 nsecs)
+{
+  guiNsecs += nsecs;
+}
+
+void GuiProfiler::addLines(int count)
+{
+  lines += count;
+}
+
+void GuiProfiler::report()
+{
+  double seconds = wall.restart() / 1000.0;
+  if (seconds <= 0) {
+    return;
+  }
+  double busyMs = guiNsecs.exchange(0) / 1000000.0;
+  qint64 count = lines.exchange(0);
+  qDebug("ingest: %.0f lines/s, GUI thread busy %.1f ms/s (%.1f%%)",
+      count / seconds, busyMs / seconds, busyMs / seconds / 10.0);
+}
+
+GuiProfileScope::GuiProfileScope()
+: profiler(GuiProfiler::instance())
+{
+  if (profiler && QThread::currentThread() != qApp->thread()) {
+    profiler = nullptr;
+  }
+  if (profiler) {
+    timer.start();
+  }
+}
+
+GuiProfileScope::~GuiProfileScope()
+{
+  if (profiler) {
+    profiler->addGuiTime(timer.nsecsElapsed());
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef D_GUIPROFILER_H
+#define D_GUIPROFILER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <atomic>
+
+// Periodically reports how much time the GUI thread spends handling log
+// ingest. Only exists when dcmon is started with --profile.
+class GuiProfiler : public QObject {
+Q_OBJECT
+public:
+  static GuiProfiler* instance();
+
+  GuiProfiler(QObject* parent = nullptr);
+  ~GuiProfiler();
+
+  void addGuiTime(qint64 nsecs);
+  void addLines(int count);
+
+private slots:
+  void report();
+
+private:
+  QTimer timer;
+  QElapsedTimer wall;
+  std::atomic<qint64> guiNsecs, lines;
+};
+
+// Adds the lifetime of the scope to the GUI time total, if profiling is
+// enabled and the scope was entered on the GUI thread.
+class GuiProfileScope {
+public:
+  GuiProfileScope();
+  ~GuiProfileScope();
+
+private:
+  GuiProfiler* profiler;
+  QElapsedTimer timer;
+};
+
+#endif
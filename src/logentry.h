@@ -0,0 +1,24 @@
+#ifndef D_LOGENTRY_H
+#define D_LOGENTRY_H
+
+#include <QString>
+#include <QVector>
+#include <QMetaType>
+#include <limits>
+
+// One finished log line, as handed from DcLog to DcLogView.
+struct LogEntry {
+  static constexpr qint64 NoTimestamp = std::numeric_limits<qint64>::min();
+
+  qint64 timestamp; // milliseconds since the epoch, UTC
+  QString container;
+  QString message;
+  // Only known when the Docker Engine API keeps stdout and stderr apart
+  bool fromStderr;
+};
+Q_DECLARE_METATYPE(LogEntry);
+
+// All of the lines produced by one read burst, in order.
+using LogBatch = QVector<LogEntry>;
+
+#endif
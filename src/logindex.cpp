@@ -0,0 +1,315 @@
+#include "logindex.h"
+#include <algorithm>
+
+static inline quint32 trigram(const char* text)
+{
+  return (quint32(uchar(text[0])) << 16) | (quint32(uchar(text[1])) << 8) | uchar(text[2]);
+}
+
+LogIndex::LogIndex()
+: growingPostings(0), firstId(0)
+{
+  // initializers only
+}
+
+void LogIndex::fold(const char* text, int length, std::string* out)
+{
+  out->clear();
+  for (int i = 0; i < length; i++) {
+    uchar c = text[i];
+    if (c >= 'A' && c <= 'Z') {
+      out->push_back(char(c + ('a' - 'A')));
+    } else if (c == 0xC5 && i + 1 < length && uchar(text[i + 1]) == 0xBF) {
+      // U+017F LATIN SMALL LETTER LONG S
+      out->push_back('s');
+      i++;
+    } else if (c == 0xE2 && i + 2 < length && uchar(text[i + 1]) == 0x84 && uchar(text[i + 2]) == 0xAA) {
+      // U+212A KELVIN SIGN
+      out->push_back('k');
+      i += 2;
+    } else {
+      out->push_back(char(c));
+    }
+  }
+}
+
+void LogIndex::add(qint64 id, const char* text, int length)
+{
+  if (blocks.empty() || blocks.back().ids.size() >= BlockLines) {
+    pack();
+    blocks.emplace_back();
+  }
+  Block& block = blocks.back();
+  quint16 line = quint16(block.ids.size());
+  block.ids.push_back(id);
+  fold(text, length, &folded);
+  for (int i = 0; i + 3 <= int(folded.size()); i++) {
+    std::vector<quint16>& list = growing[trigram(folded.data() + i)];
+    // A trigram that repeats within a line is only listed once
+    if (list.empty() || list.back() != line) {
+      list.push_back(line);
+      growingPostings++;
+    }
+  }
+}
+
+void LogIndex::pack()
+{
+  if (blocks.empty()) {
+    return;
+  }
+  Block& block = blocks.back();
+  block.keys.reserve(growing.size());
+  for (auto iter = growing.constBegin(); iter != growing.constEnd(); ++iter) {
+    block.keys.push_back(iter.key());
+  }
+  std::sort(block.keys.begin(), block.keys.end());
+  block.starts.reserve(block.keys.size() + 1);
+  block.postings.reserve(growingPostings);
+  for (quint32 key : block.keys) {
+    const std::vector<quint16>& list = growing[key];
+    block.starts.push_back(block.postings.size());
+    block.postings.insert(block.postings.end(), list.begin(), list.end());
+  }
+  block.starts.push_back(block.postings.size());
+  growing.clear();
+  growingPostings = 0;
+}
+
+void LogIndex::removeBefore(qint64 id)
+{
+  firstId = qMax(firstId, id);
+  while (!blocks.empty() && blocks.front().ids.back() < firstId) {
+    if (blocks.size() == 1) {
+      growing.clear();
+      growingPostings = 0;
+    }
+    blocks.pop_front();
+  }
+}
+
+void LogIndex::clear()
+{
+  blocks.clear();
+  growing.clear();
+  growingPostings = 0;
+}
+
+qint64 LogIndex::memoryUsage() const
+{
+  qint64 total = 0;
+  for (const Block& block : blocks) {
+    total += block.ids.capacity() * sizeof(qint64);
+    total += (block.keys.capacity() + block.starts.capacity()) * sizeof(quint32);
+    total += block.postings.capacity() * sizeof(quint16);
+  }
+  // Roughly a hash node and a vector header per trigram
+  total += growing.size() * (sizeof(void*) * 2 + sizeof(quint32) + sizeof(std::vector<quint16>));
+  total += growingPostings * sizeof(quint16);
+  return total;
+}
+
+// Returns the position of the ']' that ends the character class starting at
+// `pos`, or -1 if there is none.
+static int skipClass(const QString& query, int pos)
+{
+  int n = query.size();
+  int i = pos + 1;
+  if (i < n && query[i] == '^') {
+    i++;
+  }
+  if (i < n && query[i] == ']') {
+    i++;
+  }
+  for (; i < n; i++) {
+    if (query[i] == '\\') {
+      i++;
+    } else if (query[i] == '[' && i + 1 < n && query[i + 1] == ':') {
+      i = query.indexOf(":]", i + 2);
+      if (i < 0) {
+        return -1;
+      }
+      i++;
+    } else if (query[i] == ']') {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Returns the position of the ')' that ends the group starting at `pos`, or
+// -1 if there is none.
+static int skipGroup(const QString& query, int pos)
+{
+  int depth = 0;
+  for (int i = pos; i < query.size(); i++) {
+    if (query[i] == '\\') {
+      i++;
+    } else if (query[i] == '[') {
+      i = skipClass(query, i);
+      if (i < 0) {
+        return -1;
+      }
+    } else if (query[i] == '(') {
+      depth++;
+    } else if (query[i] == ')' && --depth == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+QList<QByteArray> LogIndex::requiredText(const QString& query, bool regexp)
+{
+  if (!regexp) {
+    return QList<QByteArray>() << query.toUtf8();
+  }
+  QList<QByteArray> result;
+  QString run;
+  int n = query.size();
+  for (int i = 0; i < n; i++) {
+    QChar c = query[i];
+    if (c == '\\') {
+      if (++i >= n || query[i] == 'Q') {
+        return QList<QByteArray>();
+      } else if (query[i].isDigit() || QStringLiteral("xocpPNkg").contains(query[i])) {
+        // Escapes such as \x41, \101, \cA, \pL or \k<name> take an argument,
+        // which must not be mistaken for literal text
+        return QList<QByteArray>();
+      } else if (query[i].isLetter()) {
+        // A character class, an assertion, or a control character
+        if (!run.isEmpty()) {
+          result << run.toUtf8();
+          run.clear();
+        }
+      } else {
+        run += query[i];
+      }
+    } else if (c == '|' || c == ')') {
+      return QList<QByteArray>();
+    } else if (c == '(' || c == '[' || c == '.' || c == '^' || c == '$' || c == '+') {
+      if (!run.isEmpty()) {
+        result << run.toUtf8();
+        run.clear();
+      }
+      if (c == '(') {
+        // Inline options such as (?i) or (?x) change how the rest is read
+        if (i + 2 < n && query[i + 1] == '?' && (query[i + 2].isLetter() || query[i + 2] == '-' || query[i + 2] == '^')) {
+          return QList<QByteArray>();
+        }
+        i = skipGroup(query, i);
+      } else if (c == '[') {
+        i = skipClass(query, i);
+      } else if (c == '+' && i + 1 < n && (query[i + 1] == '?' || query[i + 1] == '+')) {
+        i++;
+      }
+      if (i < 0) {
+        return QList<QByteArray>();
+      }
+    } else if (c == '?' || c == '*' || c == '{') {
+      // The character before the quantifier may not be there at all
+      if (!run.isEmpty()) {
+        run.chop(run.size() >= 2 && run.back().isLowSurrogate() ? 2 : 1);
+        if (!run.isEmpty()) {
+          result << run.toUtf8();
+          run.clear();
+        }
+      }
+      if (c == '{') {
+        i = query.indexOf('}', i);
+        if (i < 0) {
+          return QList<QByteArray>();
+        }
+      }
+      if (i + 1 < n && (query[i + 1] == '?' || query[i + 1] == '+')) {
+        i++;
+      }
+    } else {
+      run += c;
+    }
+  }
+  if (!run.isEmpty()) {
+    result << run.toUtf8();
+  }
+  return result;
+}
+
+bool LogIndex::candidates(const QList<QByteArray>& required, bool caseSensitive, QSet<qint64>* ids) const
+{
+  std::vector<quint32> keys;
+  std::string text;
+  for (const QByteArray& part : required) {
+    fold(part.constData(), part.size(), &text);
+    for (int i = 0; i + 3 <= int(text.size()); i++) {
+      // Non-ASCII text may match other text of a different length when case
+      // is ignored, so only ASCII trigrams can rule lines out
+      if (!caseSensitive && (uchar(text[i]) >= 0x80 || uchar(text[i + 1]) >= 0x80 || uchar(text[i + 2]) >= 0x80)) {
+        continue;
+      }
+      keys.push_back(trigram(text.data() + i));
+    }
+  }
+  if (keys.empty()) {
+    return false;
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  typedef std::pair<const quint16*, const quint16*> Range;
+  std::vector<std::vector<Range>> blockLists(blocks.size());
+  qint64 lines = 0, estimate = 0;
+  for (int b = 0; b < int(blocks.size()); b++) {
+    const Block& block = blocks[b];
+    bool packed = b + 1 < int(blocks.size());
+    std::vector<Range>& lists = blockLists[b];
+    lines += block.ids.size();
+    for (quint32 key : keys) {
+      Range list(nullptr, nullptr);
+      if (packed) {
+        auto iter = std::lower_bound(block.keys.begin(), block.keys.end(), key);
+        if (iter != block.keys.end() && *iter == key) {
+          int k = iter - block.keys.begin();
+          list = Range(block.postings.data() + block.starts[k], block.postings.data() + block.starts[k + 1]);
+        }
+      } else {
+        auto iter = growing.constFind(key);
+        if (iter != growing.constEnd()) {
+          list = Range(iter->data(), iter->data() + iter->size());
+        }
+      }
+      if (list.first == list.second) {
+        lists.clear();
+        break;
+      }
+      lists.push_back(list);
+    }
+    if (!lists.empty()) {
+      std::sort(lists.begin(), lists.end(), [](const Range& lhs, const Range& rhs) {
+        return lhs.second - lhs.first < rhs.second - rhs.first;
+      });
+      estimate += lists[0].second - lists[0].first;
+    }
+  }
+  if (estimate > lines / 4) {
+    // Collecting most of the lines would take longer than scanning them all
+    return false;
+  }
+  for (int b = 0; b < int(blocks.size()); b++) {
+    const Block& block = blocks[b];
+    const std::vector<Range>& lists = blockLists[b];
+    if (lists.empty()) {
+      continue;
+    }
+    // Check each line of the shortest list against the others
+    for (const quint16* line = lists[0].first; line != lists[0].second; line++) {
+      bool found = true;
+      for (int i = 1; found && i < int(lists.size()); i++) {
+        found = std::binary_search(lists[i].first, lists[i].second, *line);
+      }
+      if (found && block.ids[*line] >= firstId) {
+        ids->insert(block.ids[*line]);
+      }
+    }
+  }
+  return true;
+}
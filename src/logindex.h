@@ -0,0 +1,74 @@
+#ifndef D_LOGINDEX_H
+#define D_LOGINDEX_H
+
+#include <QByteArray>
+#include <QString>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <deque>
+#include <string>
+#include <vector>
+
+// A trigram index over one container's top-level log lines, so that a search
+// for literal text only has to look at the lines that might contain it. Every
+// run of three bytes in a line's UTF-8 text has a posting list of the lines
+// it appears in. A query's candidates are the lines that appear in the lists
+// of all of its trigrams, and they still have to be matched.
+//
+// ASCII letters are folded to lower case before indexing, along with the two
+// non-ASCII characters that match ASCII letters when case is ignored, so the
+// same index serves case-sensitive and case-insensitive searches.
+//
+// Lines are indexed in blocks of BlockLines, so that evicting the oldest
+// lines frees whole blocks, in the same way that LogStore frees text chunks.
+// Only the newest block still grows; the others are packed into sorted
+// arrays.
+class LogIndex {
+public:
+  LogIndex();
+
+  // Lines must be added in the order of their ids.
+  void add(qint64 id, const char* text, int length);
+  // Forgets the lines older than the given id
+  void removeBefore(qint64 id);
+  void clear();
+
+  // Approximate heap memory held
+  qint64 memoryUsage() const;
+
+  // Returns text that every match of the query must contain, or an empty
+  // list if there is none that is certain. A regular expression only yields
+  // the literal text outside of groups, classes and optional characters, and
+  // nothing at all if it has a top-level alternative or an escape that takes
+  // an argument.
+  static QList<QByteArray> requiredText(const QString& query, bool regexp);
+  // Collects the indexed lines that could contain all of the required text.
+  // Returns false if the text is too short or too common for the index to
+  // narrow the search usefully.
+  bool candidates(const QList<QByteArray>& required, bool caseSensitive, QSet<qint64>* ids) const;
+
+private:
+  enum { BlockLines = 4096 };
+
+  // A packed block. The postings of keys[i] are postings[starts[i]] up to
+  // postings[starts[i + 1]], each being a line's position in ids.
+  struct Block {
+    std::vector<qint64> ids;
+    std::vector<quint32> keys;
+    std::vector<quint32> starts;
+    std::vector<quint16> postings;
+  };
+
+  static void fold(const char* text, int length, std::string* out);
+  void pack();
+
+  std::deque<Block> blocks;
+  // The postings of the newest block, which is blocks.back()
+  QHash<quint32, std::vector<quint16>> growing;
+  qint64 growingPostings;
+  qint64 firstId;
+  std::string folded;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "logmatcher.h"
+#include <QtAlgorithms>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define D_USE_SSE2
+#endif
+
+static inline uchar foldAscii(uchar c)
+{
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// Compares `length` bytes of text with the needle, which is already folded if
+// `fold` is set.
+static inline bool equalAt(const uchar* text, const uchar* needle, int length, bool fold)
+{
+  if (!fold) {
+    return std::memcmp(text, needle, length) == 0;
+  }
+  for (int i = 0; i < length; i++) {
+    if (foldAscii(text[i]) != needle[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool findBytes(const uchar* text, int length, const uchar* needle, int needleLength, bool fold)
+{
+  if (needleLength == 0) {
+    return true;
+  }
+  int last = needleLength - 1;
+  int i = 0;
+#ifdef D_USE_SSE2
+  // Finds where both the first and the last byte of the needle line up, and
+  // only compares the bytes between them at those positions. When folding, a
+  // letter matches either case by setting the 0x20 bit of the text first;
+  // only the two cases of that letter compare equal afterwards.
+  uchar firstMask = (fold && needle[0] >= 'a' && needle[0] <= 'z') ? 0x20 : 0;
+  uchar lastMask = (fold && needle[last] >= 'a' && needle[last] <= 'z') ? 0x20 : 0;
+  __m128i first = _mm_set1_epi8(char(needle[0]));
+  __m128i lastByte = _mm_set1_epi8(char(needle[last]));
+  __m128i firstOr = _mm_set1_epi8(char(firstMask));
+  __m128i lastOr = _mm_set1_epi8(char(lastMask));
+  for (; i + last + 16 <= length; i += 16) {
+    __m128i a = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i)), firstOr);
+    __m128i b = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + last)), lastOr);
+    uint mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, lastByte)));
+    while (mask) {
+      int offset = qCountTrailingZeroBits(mask);
+      if (needleLength <= 2 || equalAt(text + i + offset + 1, needle + 1, needleLength - 2, fold)) {
+        return true;
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+  if (!fold) {
+    while (i + last < length) {
+      const void* found = std::memchr(text + i, needle[0], length - last - i);
+      if (!found) {
+        return false;
+      }
+      i = static_cast<const uchar*>(found) - text;
+      if (std::memcmp(text + i + 1, needle + 1, last) == 0) {
+        return true;
+      }
+      i++;
+    }
+    return false;
+  }
+  for (; i + last < length; i++) {
+    if (foldAscii(text[i]) == needle[0] && equalAt(text + i + 1, needle + 1, last, true)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool hasNonAscii(const uchar* text, int length)
+{
+  for (int i = 0; i < length; i++) {
+    if (text[i] >= 0x80) {
+      return true;
+    }
+  }
+  return false;
+}
+
+LogMatcher::LogMatcher()
+: regexp(false), caseSensitive(true), asciiFold(false), foldSpecial(false)
+{
+  // initializers only
+}
+
+LogMatcher::LogMatcher(const QString& query, bool regexp, bool caseSensitive)
+: query(query), regexp(regexp), caseSensitive(caseSensitive), asciiFold(false), foldSpecial(false)
+{
+  if (regexp) {
+    re.setPattern(query);
+    if (caseSensitive) {
+      re.setPatternOptions(QRegularExpression::UseUnicodePropertiesOption);
+    } else {
+      re.setPatternOptions(QRegularExpression::UseUnicodePropertiesOption | QRegularExpression::CaseInsensitiveOption);
+    }
+    re.optimize();
+    return;
+  }
+  needle = query.toUtf8();
+  if (!caseSensitive && !hasNonAscii(reinterpret_cast<const uchar*>(needle.constData()), needle.size())) {
+    asciiFold = true;
+    needle = needle.toLower();
+    foldSpecial = needle.contains('k') || needle.contains('s');
+  }
+}
+
+bool LogMatcher::isValid() const
+{
+  return regexp ? re.isValid() : !query.isEmpty();
+}
+
+bool LogMatcher::matches(const QString& text) const
+{
+  if (regexp) {
+    return re.match(text).hasMatch();
+  }
+  return text.contains(query, caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+}
+
+bool LogMatcher::matches(const char* utf8, int length) const
+{
+  const uchar* text = reinterpret_cast<const uchar*>(utf8);
+  if (regexp) {
+    return re.match(QString::fromUtf8(utf8, length)).hasMatch();
+  } else if (caseSensitive || asciiFold) {
+    const uchar* bytes = reinterpret_cast<const uchar*>(needle.constData());
+    if (findBytes(text, length, bytes, needle.size(), asciiFold)) {
+      return true;
+    } else if (!foldSpecial || !hasNonAscii(text, length)) {
+      return false;
+    }
+  }
+  return QString::fromUtf8(utf8, length).contains(query, Qt::CaseInsensitive);
+}
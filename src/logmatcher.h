@@ -0,0 +1,38 @@
+#ifndef D_LOGMATCHER_H
+#define D_LOGMATCHER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QRegularExpression>
+#include <QMetaType>
+
+// Matches log lines against a search query. A regular expression goes
+// through QRegularExpression, but plain text is looked for directly in the
+// line's UTF-8, without decoding it or running it through PCRE. Where SSE2 is
+// available, candidate positions are found 16 bytes at a time by comparing
+// the first and last bytes of the text. Ignoring case, ASCII text is folded on
+// the fly, and only other text falls back to QString's comparison.
+class LogMatcher {
+public:
+  LogMatcher();
+  LogMatcher(const QString& query, bool regexp, bool caseSensitive);
+
+  // False for an empty query or an invalid regular expression
+  bool isValid() const;
+
+  bool matches(const QString& text) const;
+  bool matches(const char* utf8, int length) const;
+
+private:
+  QString query;
+  QRegularExpression re;
+  // The query's UTF-8, in lower case if asciiFold is set
+  QByteArray needle;
+  bool regexp, caseSensitive, asciiFold;
+  // Set if the folded query has a 'k' or an 's', which also match the
+  // Kelvin sign and the long s, so lines with other text need a full check
+  bool foldSpecial;
+};
+Q_DECLARE_METATYPE(LogMatcher);
+
+#endif
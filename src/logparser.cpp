@@ -0,0 +1,326 @@
+#include "logparser.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define D_X86_SIMD
+#endif
+
+static inline bool isSpace(char ch)
+{
+  return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+static inline bool isDigit(char ch)
+{
+  return ch >= '0' && ch <= '9';
+}
+
+bool parseComposeLine(const char* line, int length, ComposeLine* parsed)
+{
+  const char* end = line + length;
+  const char* pipe = static_cast<const char*>(std::memchr(line, '|', length));
+  if (!pipe) {
+    return false;
+  }
+
+  const char* start = line;
+  const char* stop = pipe;
+  while (start < stop && isSpace(*start)) {
+    ++start;
+  }
+  while (stop > start && isSpace(stop[-1])) {
+    --stop;
+  }
+  parsed->container = start;
+  parsed->containerLength = stop - start;
+
+  const char* body = (end - pipe > 2) ? pipe + 2 : end;
+  const char* zPos = nullptr;
+  for (const char* p = body; p < end - 1; p++) {
+    p = static_cast<const char*>(std::memchr(p, 'Z', end - 1 - p));
+    if (!p) {
+      break;
+    } else if (p[1] == ' ') {
+      zPos = p;
+      break;
+    }
+  }
+
+  if (zPos) {
+    parsed->timestamp = body;
+    parsed->timestampLength = zPos + 1 - body;
+    parsed->message = zPos + 2;
+  } else {
+    parsed->timestamp = nullptr;
+    parsed->timestampLength = 0;
+    parsed->message = body;
+  }
+  parsed->messageLength = end - parsed->message;
+  return true;
+}
+
+bool parseTimestampedLine(const char* line, int length, ComposeLine* parsed)
+{
+  const char* space = static_cast<const char*>(std::memchr(line, ' ', length));
+  if (!space || space == line || space[-1] != 'Z') {
+    return false;
+  }
+  parsed->container = line;
+  parsed->containerLength = 0;
+  parsed->timestamp = line;
+  parsed->timestampLength = space - line;
+  parsed->message = space + 1;
+  parsed->messageLength = line + length - parsed->message;
+  return true;
+}
+
+static inline bool readDigits(const char* p, int count, int* value)
+{
+  int result = 0;
+  for (int i = 0; i < count; i++) {
+    if (!isDigit(p[i])) {
+      return false;
+    }
+    result = result * 10 + (p[i] - '0');
+  }
+  *value = result;
+  return true;
+}
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar
+static qint64 daysFromCivil(int y, int m, int d)
+{
+  y -= m <= 2;
+  int era = (y >= 0 ? y : y - 399) / 400;
+  int yoe = y - era * 400;
+  int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return qint64(era) * 146097 + doe - 719468;
+}
+
+bool parseDockerTimestamp(const char* text, int length, qint64* nsecs)
+{
+  // 2006-01-02T15:04:05Z is the shortest valid form
+  if (length < 20 || text[4] != '-' || text[7] != '-' || text[10] != 'T' || text[13] != ':' || text[16] != ':') {
+    return false;
+  }
+  int year, month, day, hour, minute, second;
+  if (!readDigits(text, 4, &year) || !readDigits(text + 5, 2, &month) || !readDigits(text + 8, 2, &day) ||
+      !readDigits(text + 11, 2, &hour) || !readDigits(text + 14, 2, &minute) || !readDigits(text + 17, 2, &second)) {
+    return false;
+  }
+  if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+    return false;
+  }
+  qint64 fraction = 0;
+  int pos = 19;
+  if (text[pos] == '.') {
+    int digits = 0;
+    for (++pos; pos < length && isDigit(text[pos]); ++pos, ++digits) {
+      if (digits < 9) {
+        fraction = fraction * 10 + (text[pos] - '0');
+      }
+    }
+    if (digits == 0) {
+      return false;
+    }
+    for (; digits < 9; ++digits) {
+      fraction *= 10;
+    }
+  }
+  if (pos != length - 1 || text[pos] != 'Z') {
+    return false;
+  }
+  qint64 seconds = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+  *nsecs = seconds * 1000000000LL + fraction;
+  return true;
+}
+
+// Matches one repetition of the application timestamp pattern:
+//   \[?\d{4}-\d{2}-\d{2}[T ]\d{2}:\d{2}(?::\d{2}(?:[.,]\d+)?)? ?(?:Z|UTC)?]?\s?
+// Every optional part is taken greedily, which gives the same result as the
+// backtracking regex because nothing after an optional part can fail.
+static const char* matchAppTimestamp(const char* p, const char* end)
+{
+  if (p < end && *p == '[') {
+    ++p;
+  }
+  int unused;
+  if (end - p < 16 || !readDigits(p, 4, &unused) || p[4] != '-' || !readDigits(p + 5, 2, &unused) || p[7] != '-' ||
+      !readDigits(p + 8, 2, &unused) || (p[10] != 'T' && p[10] != ' ') || !readDigits(p + 11, 2, &unused) ||
+      p[13] != ':' || !readDigits(p + 14, 2, &unused)) {
+    return nullptr;
+  }
+  p += 16;
+  if (end - p >= 3 && p[0] == ':' && isDigit(p[1]) && isDigit(p[2])) {
+    p += 3;
+    if (end - p >= 2 && (p[0] == '.' || p[0] == ',') && isDigit(p[1])) {
+      p += 2;
+      while (p < end && isDigit(*p)) {
+        ++p;
+      }
+    }
+  }
+  if (p < end && *p == ' ') {
+    ++p;
+  }
+  if (p < end && *p == 'Z') {
+    ++p;
+  } else if (end - p >= 3 && p[0] == 'U' && p[1] == 'T' && p[2] == 'C') {
+    p += 3;
+  }
+  if (p < end && *p == ']') {
+    ++p;
+  }
+  if (p < end && isSpace(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+int appTimestampLength(const char* text, int length)
+{
+  const char* end = text + length;
+  const char* p = text;
+  while (p < end && isSpace(*p)) {
+    ++p;
+  }
+  const char* matched = nullptr;
+  int repetitions = 0;
+  while (const char* next = matchAppTimestamp(p, end)) {
+    if (++repetitions > 4) {
+      return -1;
+    }
+    matched = p = next;
+  }
+  return matched ? matched - text : 0;
+}
+
+static const char* findEscScalar(const char* p, const char* end)
+{
+  while (p < end && *p != 27) {
+    ++p;
+  }
+  return p;
+}
+
+#ifdef D_X86_SIMD
+__attribute__((target("sse2")))
+static const char* findEscSse2(const char* p, const char* end)
+{
+  const __m128i esc = _mm_set1_epi8(27);
+  while (end - p >= 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, esc));
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 16;
+  }
+  return findEscScalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* findEscAvx2(const char* p, const char* end)
+{
+  const __m256i esc = _mm256_set1_epi8(27);
+  while (end - p >= 32) {
+    __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    unsigned int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, esc));
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 32;
+  }
+  return findEscSse2(p, end);
+}
+#endif
+
+using FindEscFunction = const char* (*)(const char*, const char*);
+
+static FindEscFunction resolveFindEsc()
+{
+#ifdef D_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return findEscAvx2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    return findEscSse2;
+  }
+#endif
+  return findEscScalar;
+}
+
+static FindEscFunction findEsc = resolveFindEsc();
+
+bool setEscScanner(EscScanner scanner)
+{
+  switch (scanner) {
+    case ScalarEscScanner:
+      findEsc = findEscScalar;
+      return true;
+#ifdef D_X86_SIMD
+    case Sse2EscScanner:
+      if (__builtin_cpu_supports("sse2")) {
+        findEsc = findEscSse2;
+        return true;
+      }
+      break;
+    case Avx2EscScanner:
+      if (__builtin_cpu_supports("avx2")) {
+        findEsc = findEscAvx2;
+        return true;
+      }
+      break;
+#else
+    default:
+      break;
+#endif
+  }
+  return false;
+}
+
+int stripColor(const char* in, int length, char* out)
+{
+  const char* p = in;
+  const char* end = in + length;
+  char* o = out;
+  while (p < end) {
+    // Copy everything up to the next escape character in one block
+    const char* esc = findEsc(p, end);
+    std::memcpy(o, p, esc - p);
+    o += esc - p;
+    p = esc;
+    if (p == end) {
+      break;
+    }
+    if (end - p <= 2 || p[1] != '[') {
+      *o++ = *p++;
+      continue;
+    }
+    const char* q = p + 2;
+    while (q < end && (isDigit(*q) || *q == ';')) {
+      ++q;
+    }
+    if (q < end && *q == 'm') {
+      p = q + 1;
+    } else if (q < end) {
+      std::memcpy(o, "<ESC>", 5);
+      o += 5;
+      ++p;
+    } else {
+      // Unterminated sequence at the end of the line is left alone
+      *o++ = *p++;
+    }
+  }
+  return o - out;
+}
+
+int trimmedLength(const char* line, int length)
+{
+  while (length > 0 && isSpace(line[length - 1])) {
+    --length;
+  }
+  return length;
+}
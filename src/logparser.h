@@ -0,0 +1,50 @@
+#ifndef D_LOGPARSER_H
+#define D_LOGPARSER_H
+
+#include <QtGlobal>
+
+// Byte-level helpers for parsing `docker-compose logs` output without
+// allocating. All pointers refer into the caller's buffer.
+
+struct ComposeLine {
+  const char* container;
+  int containerLength;
+  const char* timestamp;
+  int timestampLength;
+  const char* message;
+  int messageLength;
+};
+
+// Splits a "container | timestamp message" line. Returns false if the line
+// has no container separator. timestamp is null if the line has none.
+bool parseComposeLine(const char* line, int length, ComposeLine* parsed);
+
+// Splits a "timestamp message" line as produced by the Docker Engine API with
+// timestamps enabled. container is left empty. Returns false if the line has
+// no timestamp.
+bool parseTimestampedLine(const char* line, int length, ComposeLine* parsed);
+
+// Parses a docker timestamp (RFC3339 in UTC, "2006-01-02T15:04:05.999999999Z")
+// into nanoseconds since the epoch. Returns false if the text isn't in that form.
+bool parseDockerTimestamp(const char* text, int length, qint64* nsecs);
+
+// Returns the length of any application-generated timestamps at the start of a
+// message, including surrounding whitespace, or 0 if there are none. Returns -1
+// if the prefix is too unusual to handle here and the caller should use a regex.
+int appTimestampLength(const char* text, int length);
+
+// Removes SGR color sequences and replaces the escape character of any other
+// CSI sequence with "<ESC>". out must have room for 5 * length bytes.
+// Returns the number of bytes written to out.
+int stripColor(const char* in, int length, char* out);
+
+// The ways stripColor() can scan for escape characters. The fastest one the
+// CPU supports is picked at startup; choosing another is meant for testing.
+// Returns false if the CPU doesn't support the chosen scanner.
+enum EscScanner { ScalarEscScanner, Sse2EscScanner, Avx2EscScanner };
+bool setEscScanner(EscScanner scanner);
+
+// Returns the length of line after removing trailing ASCII whitespace.
+int trimmedLength(const char* line, int length);
+
+#endif
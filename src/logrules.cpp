@@ -0,0 +1,66 @@
+#include "logrules.h"
+#include <stdexcept>
+
+void LogRules::addRule(Action action, Match match, const QString& pattern, const QString& replacement)
+{
+  Rule rule;
+  rule.action = action;
+  rule.match = match;
+  rule.pattern = pattern;
+  rule.replacement = replacement;
+  if (rule.match == Literal) {
+    rule.literal.setPattern(pattern);
+  } else if (rule.match == Regex) {
+    rule.regex.setPattern(pattern);
+    if (!rule.regex.isValid()) {
+      throw std::runtime_error(QString("invalid regex /%1/: %2").arg(pattern).arg(rule.regex.errorString()).toUtf8().constData());
+    }
+    rule.regex.optimize();
+  }
+  rules << rule;
+}
+
+bool LogRules::matches(const Rule& rule, const QString& message)
+{
+  switch (rule.match) {
+    case Any:
+      return true;
+    case Literal:
+      return rule.literal.indexIn(message) >= 0;
+    case Prefix:
+      return message.startsWith(rule.pattern);
+    case Regex:
+      return rule.regex.match(message).hasMatch();
+  }
+  return false;
+}
+
+bool LogRules::apply(QString* message) const
+{
+  for (const Rule& rule : rules) {
+    if (rule.action != Replace) {
+      if (matches(rule, *message)) {
+        return rule.action == Keep;
+      }
+      continue;
+    }
+    // Replacing a literal or regex is a no-op when it doesn't match, so there's no need to test first
+    switch (rule.match) {
+      case Any:
+        *message = rule.replacement;
+        break;
+      case Literal:
+        message->replace(rule.pattern, rule.replacement);
+        break;
+      case Prefix:
+        if (message->startsWith(rule.pattern)) {
+          message->replace(0, rule.pattern.length(), rule.replacement);
+        }
+        break;
+      case Regex:
+        message->replace(rule.regex, rule.replacement);
+        break;
+    }
+  }
+  return true;
+}
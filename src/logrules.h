@@ -0,0 +1,40 @@
+#ifndef D_LOGRULES_H
+#define D_LOGRULES_H
+
+#include <QString>
+#include <QStringMatcher>
+#include <QRegularExpression>
+#include <QVector>
+
+// A container's declarative filter rules from dcmon.lua, compiled so that
+// DcLog can apply them without calling into Lua. Rules are checked in order:
+// the first matching "drop" or "keep" rule decides the line's fate, while a
+// matching "replace" rule rewrites the line and checking continues.
+class LogRules {
+public:
+  enum Action { Drop, Keep, Replace };
+  enum Match { Any, Literal, Prefix, Regex };
+
+  // Throws std::runtime_error if the pattern is an invalid regular expression.
+  void addRule(Action action, Match match, const QString& pattern, const QString& replacement = QString());
+
+  inline bool isEmpty() const { return rules.isEmpty(); }
+
+  // Returns false if the line should be dropped.
+  bool apply(QString* message) const;
+
+private:
+  struct Rule {
+    Action action;
+    Match match;
+    QString pattern, replacement;
+    QStringMatcher literal;
+    QRegularExpression regex;
+  };
+
+  static bool matches(const Rule& rule, const QString& message);
+
+  QVector<Rule> rules;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include "logsearch.h"
+#include <QElapsedTimer>
+
+// Matches found so far are delivered at most this often, in milliseconds
+#define CHUNK_INTERVAL 100
+
+LogSearch::LogSearch(QObject* parent) : QObject(parent), generation(0)
+{
+  qRegisterMetaType<LogSnapshot>("LogSnapshot");
+  qRegisterMetaType<LogMatcher>("LogMatcher");
+  qRegisterMetaType<QVector<qint64>>("QVector<qint64>");
+}
+
+int LogSearch::restart()
+{
+  return generation.fetchAndAddOrdered(1) + 1;
+}
+
+void LogSearch::cancel()
+{
+  generation.ref();
+}
+
+void LogSearch::search(int gen, const LogMatcher& matcher, const LogSnapshot& snapshot)
+{
+  QElapsedTimer timer;
+  timer.start();
+  QVector<qint64> found;
+  for (int i = snapshot.ids.size() - 1; i >= 0; --i) {
+    if ((i & 0xff) == 0 && generation.loadAcquire() != gen) {
+      return;
+    }
+    int start = i ? snapshot.ends[i - 1] : 0;
+    if (matcher.matches(snapshot.text.constData() + start, snapshot.ends[i] - start)) {
+      found << snapshot.ids[i];
+    }
+    if (!found.isEmpty() && timer.elapsed() >= CHUNK_INTERVAL) {
+      emit matched(gen, found, false);
+      found.clear();
+      timer.restart();
+    }
+  }
+  if (generation.loadAcquire() == gen) {
+    emit matched(gen, found, true);
+  }
+}
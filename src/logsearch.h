@@ -0,0 +1,46 @@
+#ifndef D_LOGSEARCH_H
+#define D_LOGSEARCH_H
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QVector>
+#include <QMetaType>
+#include "logmatcher.h"
+
+// A copy of a log's top-level lines, taken on the GUI thread so that it can
+// be searched on another one. Line i's UTF-8 text ends at ends[i]. The
+// snapshot covers the ids [start, end); lines in that range that are missing
+// from ids were ruled out before it was taken.
+struct LogSnapshot {
+  qint64 start = 0, end = 0;
+  QVector<qint64> ids;
+  QVector<int> ends;
+  QByteArray text;
+};
+Q_DECLARE_METATYPE(LogSnapshot);
+
+// Searches snapshots on a worker thread (see DcLogView). Matches are reported
+// a chunk at a time, newest first, so that the lines nearest the tail show up
+// first. Starting another search stops the one in progress.
+class LogSearch : public QObject {
+Q_OBJECT
+public:
+  LogSearch(QObject* parent = nullptr);
+
+  // These may be called from any thread. restart() returns the generation to
+  // pass to search().
+  int restart();
+  void cancel();
+
+public slots:
+  void search(int generation, const LogMatcher& matcher, const LogSnapshot& snapshot);
+
+signals:
+  void matched(int generation, const QVector<qint64>& ids, bool finished);
+
+private:
+  QAtomicInt generation;
+};
+
+#endif
@@ -0,0 +1,335 @@
+#include "logspill.h"
+#include "logstore.h"
+#include <QTemporaryFile>
+#include <QDir>
+#include <cstring>
+#include <limits>
+
+LogSpill::LogSpill()
+: spilledTopLevel(0), spilledBytes(0), endId(0), windowFirstId(0), windowFirstOrdinal(0), firstChildList(0)
+{
+  // initializers only
+}
+
+LogSpill::~LogSpill()
+{
+  clear();
+}
+
+void LogSpill::append(const LogStore& store, int count)
+{
+  if (count <= 0 || failed()) {
+    return;
+  }
+  qint64 first = store.topLevelId(0);
+  qint64 end = count < store.topLevelCount() ? store.topLevelId(count) : store.endId();
+  if (!spilledTopLevel) {
+    endId = first;
+    windowFirstId = first;
+  }
+  bool open = !window.topLevel.empty();
+  int topRow = 0;
+  for (qint64 id = first; id < end; id++) {
+    qint64 parent = store.parentId(id);
+    quint32 parentOffset = parent < 0 ? 0 : quint32(id - parent);
+    qint64 timestamp = parent < 0 ? store.timestamp(topRow++) : 0;
+    int length;
+    const char* text = store.utf8(id, &length);
+    qint64 location = write(parentOffset, timestamp, text, length, store.fromStderr(id));
+    if (location < 0) {
+      return;
+    }
+    if (!parentOffset) {
+      if (spilledTopLevel % IndexStride == 0) {
+        index.push_back(IndexEntry{ id, location });
+      }
+      if (open) {
+        addNode(&window, windowFirstId, firstChildList, id, location, 0, timestamp, spilledTopLevel);
+      }
+      ++spilledTopLevel;
+    } else if (open) {
+      addNode(&window, windowFirstId, firstChildList, id, location, parentOffset, 0, 0);
+    }
+  }
+  endId = end;
+  if (!open) {
+    windowFirstId = endId;
+    windowFirstOrdinal = spilledTopLevel;
+  }
+}
+
+bool LogSpill::failed() const
+{
+  return !error.isEmpty();
+}
+
+QString LogSpill::errorString() const
+{
+  return error;
+}
+
+qint64 LogSpill::write(quint32 parent, qint64 timestamp, const char* text, int length, bool fromStderr)
+{
+  // A record never straddles two segments
+  int size = sizeof(RecordHeader) + (parent ? 0 : sizeof(qint64)) + length;
+  if (segments.empty() || (segmentSizes.back() > 0 && segmentSizes.back() + size > SegmentSize)) {
+    QTemporaryFile* file = new QTemporaryFile(QDir::temp().filePath("dcmon-spill-XXXXXX"));
+    if (!file->open()) {
+      error = file->errorString();
+      qWarning("Could not create a spill file: %s", qPrintable(error));
+      delete file;
+      return -1;
+    }
+    segments.push_back(file);
+    segmentSizes.push_back(0);
+    mapped.push_back(nullptr);
+    mappedSize.push_back(0);
+  }
+  QTemporaryFile* file = segments.back();
+  qint64 location = (qint64(segments.size() - 1) << SegmentBits) | segmentSizes.back();
+  RecordHeader header{ quint32(length), fromStderr, parent };
+  bool ok = file->write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+  if (ok && !parent) {
+    ok = file->write(reinterpret_cast<const char*>(&timestamp), sizeof(timestamp)) == sizeof(timestamp);
+  }
+  if (ok) {
+    ok = file->write(text, length) == length;
+  }
+  if (!ok) {
+    error = file->errorString();
+    qWarning("Could not write to a spill file: %s", qPrintable(error));
+    return -1;
+  }
+  segmentSizes.back() += size;
+  spilledBytes += size;
+  return location;
+}
+
+const uchar* LogSpill::map(qint64 location, qint64 size) const
+{
+  int segment = int(location >> SegmentBits);
+  qint64 offset = location & ((qint64(1) << SegmentBits) - 1);
+  if (mappedSize[segment] < offset + size) {
+    // The segment has grown since it was last mapped
+    QTemporaryFile* file = segments[segment];
+    if (mapped[segment]) {
+      file->unmap(const_cast<uchar*>(mapped[segment]));
+    }
+    file->flush();
+    mapped[segment] = file->map(0, segmentSizes[segment]);
+    mappedSize[segment] = mapped[segment] ? segmentSizes[segment] : 0;
+    if (!mapped[segment]) {
+      return nullptr;
+    }
+  }
+  return mapped[segment] + offset;
+}
+
+qint64 LogSpill::nextRecord(qint64 location, RecordHeader* header) const
+{
+  const uchar* data = map(location, sizeof(RecordHeader));
+  if (!data) {
+    return -1;
+  }
+  std::memcpy(header, data, sizeof(RecordHeader));
+  qint64 next = location + sizeof(RecordHeader) + (header->parent ? 0 : sizeof(qint64)) + header->length;
+  int segment = int(location >> SegmentBits);
+  if ((next & ((qint64(1) << SegmentBits) - 1)) >= segmentSizes[segment]) {
+    next = qint64(segment + 1) << SegmentBits;
+  }
+  return next;
+}
+
+void LogSpill::addNode(Page* page, qint64 firstId, qint64 firstChildList, qint64 id, qint64 location, quint32 parent, qint64 timestamp, qint64 ordinal)
+{
+  quint32 row;
+  if (!parent) {
+    row = quint32(ordinal);
+    page->topLevel.push_back(TopLevel{ id, timestamp });
+  } else {
+    Node& p = page->nodes[id - parent - firstId];
+    if (p.children < 0) {
+      p.children = firstChildList + page->childLists.size();
+      page->childLists.emplace_back();
+    }
+    std::vector<quint32>& children = page->childLists[p.children - firstChildList];
+    row = children.size();
+    children.push_back(parent);
+  }
+  page->nodes.push_back(Node{ location, row, parent, -1 });
+}
+
+int LogSpill::unloadedCount() const
+{
+  return int(qMin<qint64>(windowFirstOrdinal, std::numeric_limits<int>::max()));
+}
+
+int LogSpill::loadPage(int count)
+{
+  pending = Page();
+  count = qMin(count, unloadedCount());
+  if (count <= 0) {
+    return 0;
+  }
+  // Start from the nearest indexed line and skip ahead to the first line of the page
+  qint64 firstOrdinal = windowFirstOrdinal - count;
+  const IndexEntry& entry = index[firstOrdinal / IndexStride];
+  qint64 ordinal = firstOrdinal - firstOrdinal % IndexStride;
+  qint64 location = entry.location;
+  qint64 pageFirstId = -1;
+  Page& page = pending;
+  RecordHeader header;
+  for (qint64 id = entry.id; id < windowFirstId; id++) {
+    qint64 next = nextRecord(location, &header);
+    if (next < 0) {
+      break;
+    }
+    if (!header.parent && ordinal++ == firstOrdinal) {
+      pageFirstId = id;
+    }
+    if (pageFirstId >= 0) {
+      qint64 timestamp = 0;
+      if (!header.parent) {
+        std::memcpy(&timestamp, map(location + sizeof(RecordHeader), sizeof(qint64)), sizeof(qint64));
+      }
+      addNode(&page, pageFirstId, 0, id, location, header.parent, timestamp, ordinal - 1);
+    }
+    location = next;
+  }
+  if (pageFirstId < 0 || pageFirstId + qint64(page.nodes.size()) != windowFirstId) {
+    qWarning("Could not read back spilled log lines");
+    pending = Page();
+    return 0;
+  }
+  return count;
+}
+
+void LogSpill::insertPage()
+{
+  Page page;
+  std::swap(page, pending);
+  if (page.topLevel.empty()) {
+    return;
+  }
+  // The page's child lists go in front of the window's
+  firstChildList -= page.childLists.size();
+  for (Node& n : page.nodes) {
+    if (n.children >= 0) {
+      n.children += firstChildList;
+    }
+  }
+  window.nodes.insert(window.nodes.begin(), page.nodes.begin(), page.nodes.end());
+  window.topLevel.insert(window.topLevel.begin(), page.topLevel.begin(), page.topLevel.end());
+  window.childLists.insert(window.childLists.begin(), page.childLists.begin(), page.childLists.end());
+  windowFirstOrdinal -= page.topLevel.size();
+  windowFirstId = page.topLevel.front().id;
+}
+
+void LogSpill::closeWindow()
+{
+  window = Page();
+  firstChildList = 0;
+  windowFirstId = endId;
+  windowFirstOrdinal = spilledTopLevel;
+}
+
+void LogSpill::clear()
+{
+  for (int i = 0; i < int(segments.size()); i++) {
+    if (mapped[i]) {
+      segments[i]->unmap(const_cast<uchar*>(mapped[i]));
+    }
+    delete segments[i];
+  }
+  segments.clear();
+  segmentSizes.clear();
+  mapped.clear();
+  mappedSize.clear();
+  index.clear();
+  spilledTopLevel = 0;
+  spilledBytes = 0;
+  closeWindow();
+}
+
+qint64 LogSpill::diskUsage() const
+{
+  return spilledBytes;
+}
+
+qint64 LogSpill::memoryUsage() const
+{
+  qint64 total = index.capacity() * sizeof(IndexEntry);
+  total += window.nodes.size() * sizeof(Node);
+  total += window.topLevel.size() * sizeof(TopLevel);
+  total += (window.nodes.size() - window.topLevel.size()) * sizeof(quint32);
+  total += window.childLists.size() * sizeof(std::vector<quint32>);
+  return total;
+}
+
+bool LogSpill::contains(qint64 id) const
+{
+  return id >= windowFirstId && id < endId;
+}
+
+int LogSpill::topLevelCount() const
+{
+  return window.topLevel.size();
+}
+
+qint64 LogSpill::topLevelId(int row) const
+{
+  return window.topLevel[row].id;
+}
+
+qint64 LogSpill::timestamp(int row) const
+{
+  return window.topLevel[row].timestamp;
+}
+
+qint64 LogSpill::parentId(qint64 id) const
+{
+  const Node& n = node(id);
+  return n.parent ? id - n.parent : -1;
+}
+
+int LogSpill::childCount(qint64 id) const
+{
+  const Node& n = node(id);
+  return n.children < 0 ? 0 : int(window.childLists[n.children - firstChildList].size());
+}
+
+qint64 LogSpill::childId(qint64 id, int row) const
+{
+  return id + window.childLists[node(id).children - firstChildList][row];
+}
+
+int LogSpill::row(qint64 id) const
+{
+  const Node& n = node(id);
+  return n.parent ? int(n.row) : int(n.row - quint32(windowFirstOrdinal));
+}
+
+QString LogSpill::text(qint64 id) const
+{
+  qint64 location = node(id).location;
+  const uchar* data = map(location, sizeof(RecordHeader));
+  if (!data) {
+    return QString();
+  }
+  RecordHeader header;
+  std::memcpy(&header, data, sizeof(RecordHeader));
+  location += sizeof(RecordHeader) + (header.parent ? 0 : sizeof(qint64));
+  data = map(location, header.length);
+  return data ? QString::fromUtf8(reinterpret_cast<const char*>(data), header.length) : QString();
+}
+
+bool LogSpill::fromStderr(qint64 id) const
+{
+  const uchar* data = map(node(id).location, sizeof(RecordHeader));
+  if (!data) {
+    return false;
+  }
+  RecordHeader header;
+  std::memcpy(&header, data, sizeof(RecordHeader));
+  return header.fromStderr;
+}
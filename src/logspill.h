@@ -0,0 +1,122 @@
+#ifndef D_LOGSPILL_H
+#define D_LOGSPILL_H
+
+#include <QString>
+#include <deque>
+#include <vector>
+class QTemporaryFile;
+class LogStore;
+
+// Keeps a container's evicted log lines on disk, so that scrollback beyond
+// the in-memory limits can still be browsed. Lines are appended to temporary
+// segment files as they leave the LogStore, keeping their ids, and every
+// IndexStride-th top-level line is indexed so that a page can be found without
+// reading the whole file.
+//
+// A window of the most recently evicted lines can be paged back in, from the
+// newest towards the oldest. Only the window's tree structure is held in
+// memory; the text is read from the mapped segment files when it is needed.
+// Once the window is open, lines evicted afterwards join it, so that the
+// window always ends where the LogStore begins. The owner closes the window
+// instead when that would grow it past its budget.
+class LogSpill {
+public:
+  LogSpill();
+  ~LogSpill();
+
+  // Writes the oldest `count` top-level lines of the store, with everything
+  // nested under them, before the store removes them. Once a write fails,
+  // nothing more is written and failed() is true.
+  void append(const LogStore& store, int count);
+  bool failed() const;
+  QString errorString() const;
+  // Number of spilled top-level lines that are older than the window
+  int unloadedCount() const;
+  // Reads up to `count` older top-level lines and returns how many were
+  // read, so that they can be announced before insertPage() prepends them
+  // to the window.
+  int loadPage(int count);
+  void insertPage();
+  void closeWindow();
+  // Discards the window and everything written so far.
+  void clear();
+
+  // Spilled bytes on disk
+  qint64 diskUsage() const;
+  // Approximate heap memory held by the index and the window
+  qint64 memoryUsage() const;
+
+  // Accessors for lines in the window, mirroring those of LogStore.
+  bool contains(qint64 id) const;
+  int topLevelCount() const;
+  qint64 topLevelId(int row) const;
+  qint64 timestamp(int row) const;
+  qint64 parentId(qint64 id) const;
+  int childCount(qint64 id) const;
+  qint64 childId(qint64 id, int row) const;
+  int row(qint64 id) const;
+  QString text(qint64 id) const;
+  bool fromStderr(qint64 id) const;
+
+private:
+  enum {
+    IndexStride = 256,
+    SegmentSize = 64 << 20,
+    SegmentBits = 40,
+  };
+
+  // Each line is written as a RecordHeader, then the timestamp for a
+  // top-level line, then the UTF-8 text.
+  struct RecordHeader {
+    quint32 length : 31;
+    quint32 fromStderr : 1;
+    quint32 parent; // offset back to the parent line, or 0 for top-level lines
+  };
+
+  struct IndexEntry {
+    qint64 id;
+    qint64 location;
+  };
+
+  struct Node {
+    qint64 location; // segment << SegmentBits | offset of the record
+    quint32 row;
+    quint32 parent;
+    qint64 children;
+  };
+
+  struct TopLevel {
+    qint64 id;
+    qint64 timestamp;
+  };
+
+  // A self-contained run of lines, built before being added to the window
+  struct Page {
+    std::deque<Node> nodes;
+    std::deque<TopLevel> topLevel;
+    std::deque<std::vector<quint32>> childLists;
+  };
+
+  const uchar* map(qint64 location, qint64 size) const;
+  qint64 write(quint32 parent, qint64 timestamp, const char* text, int length, bool fromStderr);
+  qint64 nextRecord(qint64 location, RecordHeader* header) const;
+  static void addNode(Page* page, qint64 firstId, qint64 firstChildList, qint64 id, qint64 location, quint32 parent, qint64 timestamp, qint64 ordinal);
+
+  inline const Node& node(qint64 id) const { return window.nodes[id - windowFirstId]; }
+
+  std::vector<QTemporaryFile*> segments;
+  std::vector<qint64> segmentSizes;
+  mutable std::vector<const uchar*> mapped;
+  mutable std::vector<qint64> mappedSize;
+  std::vector<IndexEntry> index;
+  qint64 spilledTopLevel, spilledBytes, endId;
+  QString error;
+
+  // The window's lines are ids [windowFirstId, endId), and its top-level
+  // lines are ordinals [windowFirstOrdinal, spilledTopLevel) among all of the
+  // spilled top-level lines.
+  Page window, pending;
+  qint64 windowFirstId, windowFirstOrdinal, firstChildList;
+};
+
+#endif
@@ -0,0 +1,358 @@
+#include "logstore.h"
+#include <algorithm>
+#include <cstring>
+
+LogStore::LogStore()
+: firstId(0), topLevelHead(0), topLevelSize(0), topLevelBase(0), bytesAppended(0), firstChildList(0), firstChunk(0), poolEnd(0),
+  _interning(false), textAppended(0), textStored(0)
+{
+  // initializers only
+}
+
+int LogStore::indentOf(const QString& message)
+{
+  int indent = 0;
+  while (indent < message.size() && message[indent].isSpace()) {
+    ++indent;
+  }
+  return indent;
+}
+
+int LogStore::topLevelCount() const
+{
+  return topLevelSize;
+}
+
+bool LogStore::contains(qint64 id) const
+{
+  return id >= firstId && id < endId();
+}
+
+qint64 LogStore::endId() const
+{
+  return firstId + qint64(nodes.size());
+}
+
+qint64 LogStore::topLevelId(int row) const
+{
+  return top(row).id;
+}
+
+qint64 LogStore::timestamp(int row) const
+{
+  return top(row).timestamp;
+}
+
+qint64 LogStore::parentId(qint64 id) const
+{
+  const Node& n = node(id);
+  return n.parent ? id - n.parent : -1;
+}
+
+int LogStore::childCount(qint64 id) const
+{
+  const Node& n = node(id);
+  return n.children < 0 ? 0 : int(childList(n).size());
+}
+
+qint64 LogStore::childId(qint64 id, int row) const
+{
+  return id + childList(node(id))[row];
+}
+
+int LogStore::row(qint64 id) const
+{
+  const Node& n = node(id);
+  // Unsigned arithmetic keeps this correct when the counter wraps
+  return n.parent ? int(n.row) : int(n.row - topLevelBase);
+}
+
+qint64 LogStore::byteSize() const
+{
+  return bytesAppended - bytesBefore(0);
+}
+
+int LogStore::countForBytes(qint64 bytes) const
+{
+  // bytesBefore() only increases, so find the first row that frees enough
+  qint64 target = bytesBefore(0) + bytes;
+  int low = 0, high = topLevelSize;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (bytesBefore(mid + 1) >= target) {
+      high = mid;
+    } else {
+      low = mid + 1;
+    }
+  }
+  return bytes > 0 ? std::min(low + 1, topLevelSize) : 0;
+}
+
+qint64 LogStore::memoryUsage() const
+{
+  qint64 total = 0;
+  for (const QByteArray& chunk : chunks) {
+    total += chunk.capacity();
+  }
+  total += nodes.size() * sizeof(Node);
+  total += (nodes.size() - topLevelSize) * sizeof(quint32);
+  total += childLists.size() * sizeof(std::vector<quint32>);
+  total += topLevel.capacity() * sizeof(TopLevel);
+  total += internTable.size() * (sizeof(uint) + sizeof(qint64) + 2 * sizeof(void*));
+  return total;
+}
+
+bool LogStore::interning() const
+{
+  return _interning;
+}
+
+void LogStore::setInterning(bool on)
+{
+  _interning = on;
+  internTable.clear();
+}
+
+double LogStore::dedupRatio() const
+{
+  return textStored ? double(textAppended) / textStored : 1.0;
+}
+
+QString LogStore::text(qint64 id) const
+{
+  int length;
+  const char* data = utf8(id, &length);
+  return QString::fromUtf8(data, length);
+}
+
+const char* LogStore::utf8(qint64 id, int* length) const
+{
+  const Node& n = node(id);
+  const QByteArray& chunk = chunks[(n.text >> ChunkBits) - firstChunk];
+  *length = n.length;
+  return chunk.constData() + (n.text & ChunkMask);
+}
+
+bool LogStore::fromStderr(qint64 id) const
+{
+  return node(id).fromStderr;
+}
+
+qint64 LogStore::parentFor(int indent) const
+{
+  if (indent == 0 || !topLevelSize) {
+    return -1;
+  }
+  // Descend along the most recent lines until reaching one that isn't indented less than the new line
+  qint64 parent = top(topLevelSize - 1).id;
+  qint64 child = parent;
+  while (node(child).indent < indent) {
+    parent = child;
+    if (node(parent).children < 0) {
+      break;
+    }
+    child = parent + childList(node(parent)).back();
+  }
+  if (node(child).indent < indent) {
+    parent = child;
+  }
+  return parent;
+}
+
+std::vector<LogStore::Insertion> LogStore::planBatch(const int* indents, int count) const
+{
+  // The path from the newest top-level line down through the newest line at
+  // each depth, which is where parentFor() looks. Lines added by the batch
+  // are marked with an id of -1.
+  struct PathNode {
+    qint64 id;
+    int indent;
+  };
+  std::vector<PathNode> path;
+  if (topLevelSize) {
+    qint64 id = top(topLevelSize - 1).id;
+    while (true) {
+      const Node& n = node(id);
+      path.push_back(PathNode{ id, int(n.indent) });
+      if (n.children < 0) {
+        break;
+      }
+      id += childList(n).back();
+    }
+  }
+
+  std::vector<Insertion> runs;
+  for (int i = 0; i < count; i++) {
+    int indent = indents[i];
+    int parent = -1;
+    if (indent > 0 && !path.empty()) {
+      // Same walk as parentFor()
+      int child = 0;
+      parent = 0;
+      while (path[child].indent < indent) {
+        parent = child;
+        if (child + 1 >= int(path.size())) {
+          break;
+        }
+        ++child;
+      }
+      if (path[child].indent < indent) {
+        parent = child;
+      }
+    }
+
+    // A line under a line from this batch belongs to the current run. Runs
+    // can't interleave: once a line lands under a shallower existing line,
+    // the deeper ones are no longer on the path.
+    if (parent < 0 || path[parent].id >= 0) {
+      qint64 anchor = parent < 0 ? -1 : path[parent].id;
+      if (runs.empty() || runs.back().parent != anchor) {
+        runs.push_back(Insertion{ anchor, anchor < 0 ? topLevelSize : childCount(anchor), 0, 0 });
+      }
+      ++runs.back().count;
+    }
+    ++runs.back().lines;
+
+    path.resize(parent + 1);
+    path.push_back(PathNode{ -1, indent });
+  }
+  return runs;
+}
+
+qint64 LogStore::append(qint64 parent, int indent, qint64 timestamp, const QString& message, bool fromStderr)
+{
+  QByteArray utf8 = message.toUtf8();
+  qint64 id = firstId + nodes.size();
+  quint32 row;
+  if (parent < 0) {
+    row = topLevelBase + quint32(topLevelSize);
+    pushTopLevel(id, timestamp, bytesAppended);
+  } else {
+    Node& p = node(parent);
+    if (p.children < 0) {
+      p.children = firstChildList + childLists.size();
+      childLists.emplace_back();
+    }
+    std::vector<quint32>& children = childLists[p.children - firstChildList];
+    row = children.size();
+    children.push_back(quint32(id - parent));
+  }
+  qint64 stored = textStored;
+  nodes.push_back(Node{ storeText(utf8), int(utf8.size()), quint32(indent), fromStderr, row, parent < 0 ? 0 : quint32(id - parent), -1 });
+  // Shared text only counts once
+  bytesAppended += (textStored - stored) + sizeof(Node) + (parent < 0 ? sizeof(TopLevel) : sizeof(quint32));
+  return id;
+}
+
+void LogStore::pushTopLevel(qint64 id, qint64 timestamp, qint64 bytesBefore)
+{
+  if (topLevelSize == int(topLevel.size())) {
+    // Grow by unrolling the ring into a buffer twice the size
+    std::vector<TopLevel> grown(std::max<size_t>(64, topLevel.size() * 2));
+    for (int i = 0; i < topLevelSize; i++) {
+      grown[i] = top(i);
+    }
+    topLevel.swap(grown);
+    topLevelHead = 0;
+  }
+  topLevel[(topLevelHead + topLevelSize) & (topLevel.size() - 1)] = TopLevel{ id, timestamp, bytesBefore };
+  ++topLevelSize;
+}
+
+qint64 LogStore::storeText(const QByteArray& utf8)
+{
+  int length = utf8.size();
+  textAppended += length;
+  uint hash = 0;
+  if (_interning && !chunks.empty()) {
+    hash = qHash(utf8);
+    qint64 shared = internTable.value(hash, -1);
+    if (shared >= 0) {
+      const QByteArray& newest = chunks.back();
+      int start = shared & ChunkMask;
+      if (start + length <= newest.size() && !std::memcmp(newest.constData() + start, utf8.constData(), length)) {
+        return shared;
+      }
+    }
+  }
+  textStored += length;
+  qint64 chunk = poolEnd >> ChunkBits;
+  if (chunks.empty() || chunk >= firstChunk + qint64(chunks.size()) || (poolEnd & ChunkMask) + length > ChunkSize) {
+    // Start a fresh chunk
+    if (poolEnd & ChunkMask) {
+      ++chunk;
+    }
+    poolEnd = chunk << ChunkBits;
+    if (chunks.empty()) {
+      firstChunk = chunk;
+    }
+    while (firstChunk + qint64(chunks.size()) < chunk) {
+      chunks.emplace_back();
+    }
+    chunks.emplace_back();
+    chunks.back().reserve(std::max<int>(length, ChunkSize));
+    internTable.clear();
+  }
+  chunks.back().append(utf8);
+  qint64 offset = poolEnd;
+  poolEnd += length;
+  if (_interning) {
+    internTable[hash ? hash : qHash(utf8)] = offset;
+  }
+  return offset;
+}
+
+void LogStore::releaseText()
+{
+  if (nodes.empty()) {
+    firstChunk += chunks.size();
+    chunks.clear();
+    internTable.clear();
+    return;
+  }
+  qint64 keep = nodes.front().text >> ChunkBits;
+  while (firstChunk < keep && !chunks.empty()) {
+    chunks.pop_front();
+    ++firstChunk;
+  }
+}
+
+void LogStore::removeFirst(int count)
+{
+  if (count <= 0) {
+    return;
+  } else if (count >= topLevelSize) {
+    clear();
+    return;
+  }
+  qint64 newFirst = top(count).id;
+  int lists = 0;
+  for (qint64 id = firstId; id < newFirst; id++) {
+    if (node(id).children >= 0) {
+      ++lists;
+    }
+  }
+  childLists.erase(childLists.begin(), childLists.begin() + lists);
+  firstChildList += lists;
+  nodes.erase(nodes.begin(), nodes.begin() + (newFirst - firstId));
+  firstId = newFirst;
+  topLevelHead = (topLevelHead + count) & (topLevel.size() - 1);
+  topLevelSize -= count;
+  topLevelBase += count;
+  releaseText();
+}
+
+void LogStore::clear()
+{
+  firstId += nodes.size();
+  nodes.clear();
+  topLevelBase += topLevelSize;
+  topLevel = std::vector<TopLevel>();
+  topLevelHead = 0;
+  topLevelSize = 0;
+  firstChildList += childLists.size();
+  childLists.clear();
+  textAppended = 0;
+  textStored = 0;
+  releaseText();
+}
@@ -0,0 +1,147 @@
+#ifndef D_LOGSTORE_H
+#define D_LOGSTORE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QHash>
+#include <deque>
+#include <vector>
+
+// Storage for one container's log lines, laid out to avoid a heap allocation
+// per line. Each line gets an id that is never reused. Lines are stored in the
+// order they arrive, which is also tree pre-order: every top-level line is
+// immediately followed by all of its nested lines, so evicting the oldest
+// top-level lines only ever removes from the front.
+//
+// Text is kept as UTF-8 in a pool of fixed-size chunks, and a chunk is freed
+// once every line in it has been evicted. Only top-level lines carry a
+// timestamp.
+//
+// With interning enabled, a line whose text is already in the newest chunk
+// shares that copy instead of adding another. Limiting this to the newest
+// chunk keeps every line's text at or after that of the lines before it, so
+// chunks can still be freed from the front.
+class LogStore {
+public:
+  LogStore();
+
+  static int indentOf(const QString& message);
+
+  int topLevelCount() const;
+  // Whether the line is still stored, as opposed to evicted
+  bool contains(qint64 id) const;
+  // The id the next appended line will get
+  qint64 endId() const;
+  qint64 topLevelId(int row) const;
+  qint64 timestamp(int row) const;
+
+  // Returns -1 for a top-level line.
+  qint64 parentId(qint64 id) const;
+  int childCount(qint64 id) const;
+  qint64 childId(qint64 id, int row) const;
+  // The line's row within its parent, or among the top-level lines
+  int row(qint64 id) const;
+
+  // Bytes used by the stored lines, counting the text and per-line overhead
+  // of nested lines as well as top-level lines.
+  qint64 byteSize() const;
+  // How many of the oldest top-level lines must be removed to free at least
+  // the given number of bytes.
+  int countForBytes(qint64 bytes) const;
+  // Approximate heap memory held, including unused chunk capacity.
+  qint64 memoryUsage() const;
+
+  bool interning() const;
+  void setInterning(bool on);
+  // Bytes of text appended for every byte stored, since the last clear()
+  double dedupRatio() const;
+
+  QString text(qint64 id) const;
+  // The line's UTF-8 text, valid until the line is evicted
+  const char* utf8(qint64 id, int* length) const;
+  bool fromStderr(qint64 id) const;
+
+  // Returns the id of the line that a new line with the given indent would be
+  // nested under, or -1 if it would be a new top-level line.
+  qint64 parentFor(int indent) const;
+
+  // A run of consecutive lines from a batch that all land under one existing
+  // parent (-1 for the top level): `count` of them become its direct children
+  // starting at row `first`, and the rest are nested under those.
+  struct Insertion {
+    qint64 parent;
+    int first;
+    int count;
+    int lines;
+  };
+  // Works out the tree that appending lines with the given indents would
+  // build, without changing anything, so that each run can be announced with
+  // a single insert notification before it is appended.
+  std::vector<Insertion> planBatch(const int* indents, int count) const;
+  qint64 append(qint64 parent, int indent, qint64 timestamp, const QString& message, bool fromStderr = false);
+
+  // Removes the oldest top-level lines along with everything nested under them.
+  void removeFirst(int count);
+  void clear();
+
+private:
+  enum { ChunkBits = 16, ChunkSize = 1 << ChunkBits, ChunkMask = ChunkSize - 1 };
+
+  struct Node {
+    qint64 text;     // offset into the text pool
+    int length;
+    quint32 indent : 31;
+    quint32 fromStderr : 1;
+    // A nested line's row never changes, because lines are only evicted along
+    // with their top-level line. A top-level line's row is relative to
+    // topLevelBase, which advances as lines are evicted from the front.
+    quint32 row;
+    quint32 parent;  // offset back to the parent line, or 0 for top-level lines
+    qint64 children; // index into childLists, or -1 if there are none
+  };
+
+  struct TopLevel {
+    qint64 id;
+    qint64 timestamp;
+    qint64 bytesBefore; // value of bytesAppended when the line was added
+  };
+
+  inline qint64 bytesBefore(int row) const { return row < topLevelSize ? top(row).bytesBefore : bytesAppended; }
+  inline const TopLevel& top(int row) const { return topLevel[(topLevelHead + row) & (topLevel.size() - 1)]; }
+  inline const Node& node(qint64 id) const { return nodes[id - firstId]; }
+  inline Node& node(qint64 id) { return nodes[id - firstId]; }
+  inline const std::vector<quint32>& childList(const Node& n) const { return childLists[n.children - firstChildList]; }
+
+  void pushTopLevel(qint64 id, qint64 timestamp, qint64 bytesBefore);
+  qint64 storeText(const QByteArray& utf8);
+  void releaseText();
+
+  std::deque<Node> nodes;
+  qint64 firstId;
+
+  // A circular buffer, so that evicting from the front never moves the rest.
+  // The capacity is always a power of two.
+  std::vector<TopLevel> topLevel;
+  int topLevelHead, topLevelSize;
+  quint32 topLevelBase;
+  qint64 bytesAppended;
+
+  // Children are recorded as offsets from their parent's id. A node only gets
+  // a list when its first child arrives, so the lists are in the same order as
+  // the nodes that own them and can be evicted from the front as well.
+  std::deque<std::vector<quint32>> childLists;
+  qint64 firstChildList;
+
+  // Lines never straddle a chunk boundary; a line longer than a chunk gets a
+  // chunk of its own, followed by empty placeholders for the offsets it covers.
+  std::deque<QByteArray> chunks;
+  qint64 firstChunk;
+  qint64 poolEnd;
+
+  // Hash of the text to its offset, for text in the newest chunk
+  bool _interning;
+  QHash<uint, qint64> internTable;
+  qint64 textAppended, textStored;
+};
+
+#endif
@@ -137,6 +137,17 @@ void LuaVM::pushStack(const QVariant& value)
     case QMetaType::QByteArray:
       lua_pushstring(L, value.value<QByteArray>().constData());
       break;
+    case QMetaType::QStringList: {
+      // Pushed as an array so that a whole list can be passed in a single call
+      QStringList list = value.toStringList();
+      lua_createtable(L, list.size(), 0);
+      for (int i = 0; i < list.size(); i++) {
+        QByteArray utf8 = list[i].toUtf8();
+        lua_pushlstring(L, utf8.constData(), utf8.size());
+        lua_seti(L, -2, i + 1);
+      }
+      break;
+    }
     case QMetaType::VoidStar:
       // TODO: heavy userdata
       lua_pushlightuserdata(L, value.value<void*>());
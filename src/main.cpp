@@ -2,6 +2,8 @@
 #include <QtDebug>
 #include "dcmonconfig.h"
 #include "dcmonwindow.h"
+#include "guiprofiler.h"
+#include <QScopedPointer>
 
 int main(int argc, char** argv) {
   QApplication::setApplicationName("dcmon");
@@ -18,6 +20,7 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  QScopedPointer<GuiProfiler> profiler(config.profile ? new GuiProfiler : nullptr);
   DcmonWindow win;
   win.resize(1024, 768);
   win.show();
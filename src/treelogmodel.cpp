@@ -1,168 +1,438 @@
 #include "treelogmodel.h"
+#include <QColor>
+#include <QDateTime>
 #include <QtDebug>
+#include <limits>
 
-TreeLogModel::LogLine::LogLine()
-: parent(nullptr)
+// A log line's internal ID is its ID in the LogStore, which it keeps once it
+// has been spilled to disk.
+#define idx_line(idx) (qint64((idx).internalId()))
+
+TreeLogModel::TreeLogModel(QObject* parent)
+: QAbstractItemModel(parent), _maxLines(10000), _maxBytes(0), spill(nullptr), textIndex(nullptr), fetchedTopLevel(0), _localTime(false), _showMilliseconds(false)
 {
-  // initializers only
+  for (CachedTime& cached : timeCache) {
+    cached.second = LogEntry::NoTimestamp;
+  }
 }
 
-TreeLogModel::LogLine::LogLine(LogLine* parent, const QString& msg, int indent)
-: parent(parent), line(msg), indent(indent)
+TreeLogModel::~TreeLogModel()
 {
-  // initializers only
+  delete spill;
+  delete textIndex;
 }
 
-TreeLogModel::LogLine::LogLine(LogLine* parent, const QDateTime& dt, const QString& msg)
-: datetime(dt), parent(parent), line(msg), indent(0)
+int TreeLogModel::maxLines() const
 {
-  // initializers only
+  return _maxLines;
 }
 
-TreeLogModel::TreeLogModel(QObject* parent)
-: QAbstractItemModel(parent), _maxLines(10000)
+void TreeLogModel::setMaxLines(int lines)
 {
-  // initializers only
+  _maxLines = lines;
+  flushOldest();
 }
 
-TreeLogModel::~TreeLogModel()
+qint64 TreeLogModel::maxBytes() const
 {
-  qDeleteAll(roots);
+  return _maxBytes;
 }
 
-TreeLogModel::LogLine::~LogLine()
+void TreeLogModel::setMaxBytes(qint64 bytes)
 {
-  qDeleteAll(children);
+  _maxBytes = bytes;
+  flushOldest();
 }
 
-int TreeLogModel::maxLines() const
+qint64 TreeLogModel::byteSize() const
 {
-  return _maxLines;
+  return store.byteSize();
 }
 
-void TreeLogModel::setMaxLines(int lines)
+qint64 TreeLogModel::memoryUsage() const
 {
-  _maxLines = lines;
-  for (const QString& name : names) {
-    flushOldest(name);
+  return store.memoryUsage() + (spill ? spill->memoryUsage() : 0) + indexSize();
+}
+
+bool TreeLogModel::spillEnabled() const
+{
+  return spill;
+}
+
+void TreeLogModel::setSpillEnabled(bool on)
+{
+  if (!on) {
+    _spillError.clear();
+  }
+  if (on && !spill && _spillError.isEmpty()) {
+    spill = new LogSpill();
+  } else if (!on && spill) {
+    int count = windowCount();
+    if (count) {
+      beginRemoveRows(QModelIndex(), 0, count - 1);
+    }
+    delete spill;
+    spill = nullptr;
+    forgetFetchedChildren();
+    if (count) {
+      endRemoveRows();
+    }
   }
 }
 
-void TreeLogModel::flushOldest(const QString& container)
+qint64 TreeLogModel::spillSize() const
 {
-  LogLine& root = *roots[container];
-  int row = names.indexOf(container);
-  int ct = root.children.size() - _maxLines;
-  if (ct <= 0) {
-    return;
+  return spill ? spill->diskUsage() : 0;
+}
+
+QString TreeLogModel::spillError() const
+{
+  return _spillError;
+}
+
+bool TreeLogModel::interning() const
+{
+  return store.interning();
+}
+
+void TreeLogModel::setInterning(bool on)
+{
+  store.setInterning(on);
+}
+
+double TreeLogModel::dedupRatio() const
+{
+  return store.dedupRatio();
+}
+
+bool TreeLogModel::indexEnabled() const
+{
+  return textIndex;
+}
+
+void TreeLogModel::setIndexEnabled(bool on)
+{
+  if (on && !textIndex) {
+    textIndex = new LogIndex();
+    for (int row = 0; row < store.topLevelCount(); row++) {
+      qint64 id = store.topLevelId(row);
+      int length;
+      const char* text = store.utf8(id, &length);
+      textIndex->add(id, text, length);
+    }
+  } else if (!on && textIndex) {
+    delete textIndex;
+    textIndex = nullptr;
   }
-  beginRemoveRows(index(row, 0, QModelIndex()), 0, ct - 1);
-  for (int i = 0; i < ct; i++) {
-    delete root.children[i];
+}
+
+qint64 TreeLogModel::indexSize() const
+{
+  return textIndex ? textIndex->memoryUsage() : 0;
+}
+
+bool TreeLogModel::indexCandidates(const QString& query, bool regexp, bool caseSensitive, QSet<qint64>* ids, qint64* start, qint64* end) const
+{
+  if (!textIndex || !textIndex->candidates(LogIndex::requiredText(query, regexp), caseSensitive, ids)) {
+    return false;
   }
-  root.children.erase(root.children.begin(), root.children.begin() + ct);
-  endRemoveRows();
+  *start = store.topLevelCount() ? store.topLevelId(0) : store.endId();
+  *end = store.endId();
+  return true;
+}
+
+void TreeLogModel::flushOldest()
+{
+  // Whichever limit is exceeded, trim to 90% of it
+  int ct = 0;
+  if (store.topLevelCount() > _maxLines) {
+    ct = store.topLevelCount() - (_maxLines - _maxLines / 10);
+  }
+  if (_maxBytes > 0 && store.byteSize() > _maxBytes) {
+    ct = qMax(ct, store.countForBytes(store.byteSize() - (_maxBytes - _maxBytes / 10)));
+  }
+  removeOldest(ct);
+}
+
+void TreeLogModel::freeBytes(qint64 bytes)
+{
+  removeOldest(store.countForBytes(bytes));
 }
 
-void TreeLogModel::addContainer(const QString& container)
+void TreeLogModel::removeOldest(int count)
 {
-  if (roots.contains(container)) {
+  if (count <= 0) {
     return;
   }
-  beginInsertRows(QModelIndex(), names.size(), names.size());
-  names << container;
-  roots[container] = new LogLine();
-  endInsertRows();
+  int window = windowCount();
+  // Lines that were never fetched go without a notification
+  int shown = window ? window + count : count - unfetchedTopLevel();
+  // Rather than grow past its budget, the window is closed and goes with the
+  // evicted lines
+  bool closing = window && window + count > MaxWindowLines;
+  if (closing) {
+    beginRemoveRows(QModelIndex(), 0, shown - 1);
+    spill->closeWindow();
+  }
+  bool failed = false;
+  if (spill) {
+    spill->append(store, count);
+    failed = spill->failed();
+  }
+  if (window && !failed && !closing) {
+    // While older lines are paged in from disk, the evicted lines join them
+    // and stay in the same rows, so there is nothing to notify
+    store.removeFirst(count);
+    removeFromIndex();
+    fetchedTopLevel -= count;
+    return;
+  }
+  // If spilling failed, the window also goes with the evicted lines
+  if (shown > 0 && !closing) {
+    beginRemoveRows(QModelIndex(), 0, shown - 1);
+  }
+  if (failed) {
+    _spillError = spill->errorString();
+    delete spill;
+    spill = nullptr;
+  }
+  store.removeFirst(count);
+  removeFromIndex();
+  if (shown > 0) {
+    fetchedTopLevel -= shown - window;
+    endRemoveRows();
+  }
+  forgetFetchedChildren();
 }
 
-void TreeLogModel::logMessage(const QDateTime& timestamp, const QString& container, const QString& message)
+void TreeLogModel::removeFromIndex()
 {
-  addContainer(container);
-  LogLine& root = *roots[container];
-  int indent = 0;
-  while (indent < message.size() && message[indent].isSpace()) {
-    ++indent;
+  if (textIndex) {
+    textIndex->removeBefore(store.topLevelCount() ? store.topLevelId(0) : store.endId());
   }
-  if (indent == 0 || !root.children.size()) {
-    beginInsertRows(index(&root, 0), root.children.size(), root.children.size());
-    root.children.push_back(new LogLine(&root, timestamp, message));
-    endInsertRows();
-  } else {
-    LogLine* parent = root.children.back();
-    LogLine* child = parent;
-    while (child->indent < indent) {
-      parent = child;
-      if (!parent->children.size()) {
-        break;
+}
+
+void TreeLogModel::forgetFetchedChildren()
+{
+  if (!fetchedChildren.isEmpty()) {
+    qint64 firstId = std::numeric_limits<qint64>::max();
+    if (windowCount()) {
+      firstId = spill->topLevelId(0);
+    } else if (store.topLevelCount()) {
+      firstId = store.topLevelId(0);
+    }
+    for (auto it = fetchedChildren.begin(); it != fetchedChildren.end(); ) {
+      if (it.key() < firstId) {
+        it = fetchedChildren.erase(it);
+      } else {
+        ++it;
       }
-      child = parent->children.back();
     }
-    if (child->indent < indent) {
-      parent = child;
+  }
+}
+
+int TreeLogModel::unfetchedTopLevel() const
+{
+  return store.topLevelCount() - fetchedTopLevel;
+}
+
+int TreeLogModel::windowCount() const
+{
+  return spill ? spill->topLevelCount() : 0;
+}
+
+qint64 TreeLogModel::parentOf(qint64 id) const
+{
+  return isSpilled(id) ? spill->parentId(id) : store.parentId(id);
+}
+
+int TreeLogModel::childCountOf(qint64 id) const
+{
+  return isSpilled(id) ? spill->childCount(id) : store.childCount(id);
+}
+
+qint64 TreeLogModel::childOf(qint64 id, int row) const
+{
+  return isSpilled(id) ? spill->childId(id, row) : store.childId(id, row);
+}
+
+int TreeLogModel::fetchedChildCount(qint64 id) const
+{
+  return fetchedChildren.value(id, qMin(childCountOf(id), int(PageSize)));
+}
+
+bool TreeLogModel::isFetched(qint64 id) const
+{
+  for (qint64 parent = store.parentId(id); parent >= 0; id = parent, parent = store.parentId(id)) {
+    if (store.row(id) >= fetchedChildCount(parent)) {
+      return false;
     }
-    beginInsertRows(index(parent, 0), parent->children.size(), parent->children.size());
-    parent->children.push_back(new LogLine(parent, message, indent));
-    endInsertRows();
   }
-  flushOldest(container);
+  return store.row(id) >= unfetchedTopLevel();
 }
 
-#define line_cast(p) const_cast<void*>((void*)static_cast<const TreeLogModel::LogLine*>(p))
-#define idx_cast(p) reinterpret_cast<TreeLogModel::LogLine*>(p.internalPointer())
+bool TreeLogModel::canFetchMore(const QModelIndex& parent) const
+{
+  if (!parent.isValid()) {
+    return unfetchedTopLevel() > 0 || (spill && spill->unloadedCount() > 0);
+  }
+  qint64 id = idx_line(parent);
+  return fetchedChildCount(id) < childCountOf(id);
+}
 
-QModelIndex TreeLogModel::index(int row, int column, const QModelIndex& parent) const
+void TreeLogModel::fetchMore(const QModelIndex& parent)
 {
   if (!parent.isValid()) {
-    if (row < names.size()) {
-      return createIndex(row, column, nullptr);
+    // Older lines go in above the ones already fetched, and once all of the
+    // stored lines are fetched, the spilled ones come next
+    int count = qMin(unfetchedTopLevel(), int(PageSize));
+    if (count > 0) {
+      beginInsertRows(QModelIndex(), 0, count - 1);
+      fetchedTopLevel += count;
+      endInsertRows();
+    } else if (spill && (count = spill->loadPage(PageSize)) > 0) {
+      beginInsertRows(QModelIndex(), 0, count - 1);
+      spill->insertPage();
+      endInsertRows();
     }
-    return QModelIndex();
+    return;
   }
-  LogLine* line = lineForIndex(parent);
-  if (!line || (quint64)row >= line->children.size()) {
-    return QModelIndex();
+  qint64 id = idx_line(parent);
+  int first = fetchedChildCount(id);
+  int count = qMin(childCountOf(id) - first, int(PageSize));
+  if (count > 0) {
+    beginInsertRows(indexForLine(id, 0), first, first + count - 1);
+    fetchedChildren[id] = first + count;
+    endInsertRows();
   }
-  return createIndex(row, column, line_cast(line->children[row]));
 }
 
-QModelIndex TreeLogModel::parent(const QModelIndex& idx) const
+void TreeLogModel::fetchAll()
+{
+  int count = unfetchedTopLevel();
+  if (count > 0) {
+    beginInsertRows(QModelIndex(), 0, count - 1);
+    fetchedTopLevel += count;
+    endInsertRows();
+  }
+}
+
+void TreeLogModel::unfetchOlder()
+{
+  // Wait for a second page to build up, so this isn't done on every append
+  int window = windowCount();
+  if (window + fetchedTopLevel <= 2 * PageSize) {
+    return;
+  }
+  int count = qMax(window + fetchedTopLevel - int(PageSize), window);
+  beginRemoveRows(QModelIndex(), 0, count - 1);
+  if (window) {
+    spill->closeWindow();
+  }
+  fetchedTopLevel -= count - window;
+  forgetFetchedChildren();
+  endRemoveRows();
+}
+
+void TreeLogModel::logMessage(qint64 timestamp, const QString& message)
 {
-  if (!idx.isValid() || !idx.internalPointer()) {
+  appendBatch(LogBatch{ LogEntry{ timestamp, QString(), message } });
+}
+
+void TreeLogModel::appendBatch(const LogBatch& entries)
+{
+  std::vector<int> indents(entries.size());
+  for (int i = 0; i < entries.size(); i++) {
+    indents[i] = LogStore::indentOf(entries[i].message);
+  }
+  int pos = 0;
+  for (const LogStore::Insertion& run : store.planBatch(indents.data(), indents.size())) {
+    // New top-level lines are always fetched. New children are only fetched
+    // if their parent is showing all of its children so far, up to a page.
+    QModelIndex parent;
+    int first, last;
+    if (run.parent < 0) {
+      first = windowCount() + fetchedTopLevel;
+      last = first + run.count - 1;
+    } else {
+      first = fetchedChildCount(run.parent);
+      last = first - 1;
+      if (first == run.first && isFetched(run.parent)) {
+        parent = indexForLine(run.parent, 0);
+        last = (fetchedChildren.contains(run.parent) ? first + run.count : qMin(first + run.count, int(PageSize))) - 1;
+      }
+    }
+    if (last >= first) {
+      beginInsertRows(parent, first, last);
+    }
+    for (int i = 0; i < run.lines; i++, pos++) {
+      qint64 parentId = store.parentFor(indents[pos]);
+      qint64 id = store.append(parentId, indents[pos], entries[pos].timestamp, entries[pos].message, entries[pos].fromStderr);
+      if (textIndex && parentId < 0) {
+        int length;
+        const char* text = store.utf8(id, &length);
+        textIndex->add(id, text, length);
+      }
+    }
+    if (run.parent < 0) {
+      fetchedTopLevel += run.count;
+    } else if (fetchedChildren.contains(run.parent)) {
+      fetchedChildren[run.parent] = last + 1;
+    }
+    if (last >= first) {
+      endInsertRows();
+    }
+  }
+}
+
+QModelIndex TreeLogModel::index(int row, int column, const QModelIndex& parent) const
+{
+  if (!parent.isValid()) {
+    int window = windowCount();
+    if (row < window) {
+      return createIndex(row, column, quintptr(spill->topLevelId(row)));
+    } else if (row - window >= fetchedTopLevel) {
+      return QModelIndex();
+    }
+    return createIndex(row, column, quintptr(store.topLevelId(unfetchedTopLevel() + row - window)));
+  }
+  qint64 id = idx_line(parent);
+  if (row >= fetchedChildCount(id)) {
     return QModelIndex();
   }
-  LogLine* line = lineForIndex(idx);
-  return index(line->parent, 0);
+  return createIndex(row, column, quintptr(childOf(id, row)));
 }
 
-QModelIndex TreeLogModel::index(LogLine* line, int column) const
+QModelIndex TreeLogModel::parent(const QModelIndex& idx) const
 {
-  if (!line->parent) {
-    return createIndex(names.indexOf(roots.key(line)), 0, nullptr);
+  if (!idx.isValid()) {
+    return QModelIndex();
   }
-  int row = find(line->parent, line);
-  if (row < 0) {
+  qint64 parent = parentOf(idx_line(idx));
+  if (parent < 0) {
     return QModelIndex();
   }
-  return createIndex(row, column, line);
+  return indexForLine(parent, 0);
 }
 
-int TreeLogModel::find(const LogLine* parent, const LogLine* child) const
+QModelIndex TreeLogModel::indexForLine(qint64 id, int column) const
 {
-  for (int i = parent->children.size() - 1; i >= 0; --i) {
-    if (parent->children[i] == child) {
-      return i;
-    }
+  if (isSpilled(id)) {
+    return createIndex(spill->row(id), column, quintptr(id));
+  }
+  int row = store.row(id);
+  if (store.parentId(id) < 0) {
+    row += windowCount() - unfetchedTopLevel();
   }
-  return -1;
+  return createIndex(row, column, quintptr(id));
 }
 
 int TreeLogModel::rowCount(const QModelIndex& parent) const
 {
   if (!parent.isValid()) {
-    return names.size();
+    return windowCount() + fetchedTopLevel;
   }
-  LogLine* line = lineForIndex(parent);
-  return line->children.size();
+  return fetchedChildCount(idx_line(parent));
 }
 
 int TreeLogModel::columnCount(const QModelIndex& parent) const
@@ -188,42 +458,64 @@ QVariant TreeLogModel::data(const QModelIndex& index, int role) const
 {
   if (role == Qt::FontRole && index.column() == 1) {
     return _logFont;
+  } else if (role == LineIdRole) {
+    return idx_line(index);
+  } else if (role == Qt::ForegroundRole && index.column() == 1) {
+    qint64 id = idx_line(index);
+    bool fromStderr = isSpilled(id) ? spill->fromStderr(id) : store.fromStderr(id);
+    return fromStderr ? QVariant(QColor(192, 48, 48)) : QVariant();
   }
-  LogLine* line = lineForIndex(index);
-  if (index.column() == 0) {
-    if (!index.parent().isValid()) {
-      if (role == Qt::DisplayRole) {
-        return names[index.row()];
-      }
-      return QVariant();
+  if (role != Qt::DisplayRole) {
+    return QVariant();
+  }
+  qint64 id = idx_line(index);
+  if (isSpilled(id)) {
+    if (index.column() == 0) {
+      return spill->parentId(id) >= 0 ? QVariant() : timestampData(spill->timestamp(index.row()));
     }
-    if (!line->parent || role != Qt::DisplayRole) {
+    return spill->text(id);
+  }
+  if (index.column() == 0) {
+    if (store.parentId(id) >= 0) {
       return QVariant();
     }
-    return line->datetime.toString("hh:mm:ss");
-  }
-  if (role == Qt::DisplayRole) {
-    return line->line;
+    return timestampData(store.timestamp(unfetchedTopLevel() + index.row() - windowCount()));
   }
-  return QVariant();
+  return store.text(id);
 }
 
-TreeLogModel::LogLine* TreeLogModel::lineForIndex(const QModelIndex& parent) const
+LogSnapshot TreeLogModel::snapshot(const QSet<qint64>* candidates, qint64 candidatesStart, qint64 candidatesEnd) const
 {
-  if (!parent.internalPointer()) {
-    return roots[names[parent.row()]];
+  LogSnapshot result;
+  int window = windowCount();
+  int first = unfetchedTopLevel();
+  if (window) {
+    result.start = spill->topLevelId(0);
   } else {
-    return idx_cast(parent);
+    result.start = first < store.topLevelCount() ? store.topLevelId(first) : store.endId();
   }
-}
-
-QModelIndex TreeLogModel::rootForContainer(const QString& name) const
-{
-  int row = names.indexOf(name);
-  if (row < 0) {
-    return QModelIndex();
+  result.end = store.endId();
+  for (int row = 0; row < window; row++) {
+    qint64 id = spill->topLevelId(row);
+    if (candidates && id >= candidatesStart && id < candidatesEnd && !candidates->contains(id)) {
+      continue;
+    }
+    result.ids << id;
+    result.text += spill->text(id).toUtf8();
+    result.ends << result.text.size();
+  }
+  for (int row = first; row < store.topLevelCount(); row++) {
+    qint64 id = store.topLevelId(row);
+    if (candidates && id >= candidatesStart && id < candidatesEnd && !candidates->contains(id)) {
+      continue;
+    }
+    int length;
+    const char* text = store.utf8(id, &length);
+    result.ids << id;
+    result.text.append(text, length);
+    result.ends << result.text.size();
   }
-  return createIndex(row, 0, nullptr);
+  return result;
 }
 
 QFont TreeLogModel::logFont() const
@@ -234,25 +526,88 @@ QFont TreeLogModel::logFont() const
 void TreeLogModel::setLogFont(const QFont& font)
 {
   _logFont = font;
-  emit dataChanged(createIndex(0, 0, nullptr), createIndex(names.size(), 0, nullptr), QVector<int>() << Qt::FontRole);
+  if (rowCount()) {
+    emit dataChanged(index(0, 1), index(rowCount() - 1, 1), QVector<int>() << Qt::FontRole);
+  }
 }
 
-void TreeLogModel::clear()
+bool TreeLogModel::localTime() const
+{
+  return _localTime;
+}
+
+void TreeLogModel::setLocalTime(bool on)
+{
+  _localTime = on;
+  timestampsChanged();
+}
+
+bool TreeLogModel::showMilliseconds() const
 {
-  for (const QString& name : names) {
-    clear(name);
+  return _showMilliseconds;
+}
+
+void TreeLogModel::setShowMilliseconds(bool on)
+{
+  _showMilliseconds = on;
+  timestampsChanged();
+}
+
+QVariant TreeLogModel::timestampData(qint64 timestamp) const
+{
+  if (timestamp == LogEntry::NoTimestamp) {
+    return QString();
   }
+  return formatTimestamp(timestamp);
 }
 
-void TreeLogModel::clear(const QString& container)
+QString TreeLogModel::formatTimestamp(qint64 timestamp) const
 {
-  int row = names.indexOf(container);
-  if (row < 0) {
-    return;
+  // Only the time zone conversion is cached; the milliseconds are cheap to append
+  qint64 second = timestamp / 1000;
+  int ms = timestamp % 1000;
+  if (ms < 0) {
+    --second;
+    ms += 1000;
+  }
+  CachedTime& cached = timeCache[second & (TimeCacheSize - 1)];
+  if (cached.second != second) {
+    cached.second = second;
+    cached.text = QDateTime::fromMSecsSinceEpoch(second * 1000, _localTime ? Qt::LocalTime : Qt::UTC).toString("hh:mm:ss");
+  }
+  if (!_showMilliseconds) {
+    return cached.text;
+  }
+  return QString("%1.%2").arg(cached.text).arg(ms, 3, 10, QChar('0'));
+}
+
+void TreeLogModel::timestampsChanged()
+{
+  for (CachedTime& cached : timeCache) {
+    cached.second = LogEntry::NoTimestamp;
+  }
+  // Rows are formatted as they are painted, so this only redraws what's on screen
+  if (rowCount()) {
+    emit dataChanged(index(0, 0), index(rowCount() - 1, 0), QVector<int>() << Qt::DisplayRole);
+  }
+}
+
+void TreeLogModel::clear()
+{
+  int count = rowCount();
+  if (count) {
+    beginRemoveRows(QModelIndex(), 0, count - 1);
+  }
+  store.clear();
+  if (spill) {
+    spill->clear();
+  }
+  if (textIndex) {
+    textIndex->clear();
+  }
+  fetchedChildren.clear();
+  if (count) {
+    fetchedTopLevel = 0;
+    endRemoveRows();
   }
-  LogLine* line = roots[container];
-  beginRemoveRows(index(row, 0, QModelIndex()), 0, line->children.size() - 1);
-  qDeleteAll(line->children);
-  line->children.clear();
-  endRemoveRows();
 }
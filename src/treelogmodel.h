@@ -2,60 +2,147 @@
 #define D_TREELOGMODEL_H
 
 #include <QAbstractItemModel>
-#include <QDateTime>
-#include <QHash>
 #include <QFont>
-#include <vector>
+#include <QHash>
+#include <QSet>
+#include "logstore.h"
+#include "logspill.h"
+#include "logindex.h"
+#include "logentry.h"
+#include "logsearch.h"
 
+// The log of a single container or filter view. Each tab has its own model,
+// so that a line appended to one container only notifies the tab showing it.
+//
+// Rows are handed to the view a page at a time. The newest top-level lines are
+// always fetched; older ones are fetched from the top as the user scrolls up,
+// and children are fetched in order as their parent is expanded. If spilling
+// is enabled, scrolling up past the stored lines pages evicted lines back in
+// from disk.
 class TreeLogModel : public QAbstractItemModel
 {
 Q_OBJECT
 public:
+  enum { PageSize = 1000 };
+  // Most top-level lines the spill window may hold before eviction closes it
+  enum { MaxWindowLines = 20 * PageSize };
+  // Data role holding the line's id, which stays the same as rows move
+  enum { LineIdRole = Qt::UserRole };
+
   TreeLogModel(QObject* parent = nullptr);
   ~TreeLogModel();
 
   int maxLines() const;
   void setMaxLines(int lines);
-  QModelIndex rootForContainer(const QString& name) const;
+  // Byte budget, counting nested lines. 0 means no limit.
+  qint64 maxBytes() const;
+  void setMaxBytes(qint64 bytes);
+
+  qint64 byteSize() const;
+  qint64 memoryUsage() const;
+
+  // Whether evicted lines are kept on disk. If writing them fails, spilling
+  // stops and evicted lines are discarded until it is turned off and on again.
+  bool spillEnabled() const;
+  void setSpillEnabled(bool on);
+  qint64 spillSize() const;
+  // Why spilling stopped, if it did
+  QString spillError() const;
+
+  // Whether lines with the same text share one copy of it
+  bool interning() const;
+  void setInterning(bool on);
+  double dedupRatio() const;
+
+  // Whether top-level lines are kept in a trigram index for searching
+  bool indexEnabled() const;
+  void setIndexEnabled(bool on);
+  qint64 indexSize() const;
+  // Uses the index to collect the stored lines that could match the query.
+  // Lines in [start, end) that aren't collected can't match. Returns false if
+  // there is no index or it can't narrow the search.
+  bool indexCandidates(const QString& query, bool regexp, bool caseSensitive, QSet<qint64>* ids, qint64* start, qint64* end) const;
 
   QFont logFont() const;
   void setLogFont(const QFont& font);
 
+  // Timestamps are shown as hh:mm:ss in UTC unless these are set.
+  bool localTime() const;
+  void setLocalTime(bool on);
+  bool showMilliseconds() const;
+  void setShowMilliseconds(bool on);
+
   QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const;
   QModelIndex parent(const QModelIndex& parent) const;
   int rowCount(const QModelIndex& parent = QModelIndex()) const;
   int columnCount(const QModelIndex& parent = QModelIndex()) const;
   QVariant headerData(int section, Qt::Orientation orientation, int role) const;
   QVariant data(const QModelIndex& index, int role) const;
+  // Copies the text of every top-level row, for searching on another thread.
+  // Given the candidates left by an earlier search or the index, rows in
+  // [candidatesStart, candidatesEnd) are only copied if they are among them.
+  LogSnapshot snapshot(const QSet<qint64>* candidates = nullptr, qint64 candidatesStart = 0, qint64 candidatesEnd = 0) const;
+
+  bool canFetchMore(const QModelIndex& parent) const;
+  void fetchMore(const QModelIndex& parent);
 
 public slots:
-  void addContainer(const QString& container);
-  void logMessage(const QDateTime& timestamp, const QString& container, const QString& message);
+  void logMessage(qint64 timestamp, const QString& message);
+  // Appends many lines with one insert notification per parent that gains
+  // children, instead of one per line.
+  void appendBatch(const LogBatch& entries);
   void clear();
-  void clear(const QString& container);
+  // Once the log has more than maxLines() top-level lines or maxBytes()
+  // bytes, trims it back to 90% of the limit, so that the view sees one
+  // removal every so often rather than one for every appended line.
+  void flushOldest();
+  // Removes the oldest lines until at least the given number of bytes are freed.
+  void freeBytes(qint64 bytes);
+  // Fetches every remaining top-level line, for a search that needs them all.
+  void fetchAll();
+  // Hides all but the newest page of top-level lines again, so that a view
+  // following the tail doesn't keep the rows it has scrolled away from.
+  void unfetchOlder();
 
 private:
-  void flushOldest(const QString& container);
-
-  struct LogLine {
-    LogLine();
-    LogLine(LogLine* parent, const QDateTime& datetime, const QString& msg);
-    LogLine(LogLine* parent, const QString& msg, int indent);
-    ~LogLine();
-    QDateTime datetime;
-    LogLine* parent;
-    QString line;
-    int indent;
-    std::vector<LogLine*> children;
-  };
+  void removeOldest(int count);
+  void removeFromIndex();
+  QModelIndex indexForLine(qint64 id, int column) const;
+  int unfetchedTopLevel() const;
+  int windowCount() const;
+  int fetchedChildCount(qint64 id) const;
+  bool isFetched(qint64 id) const;
+  void forgetFetchedChildren();
+
+  // Look up a line in the store or, once evicted, in the spill window
+  inline bool isSpilled(qint64 id) const { return spill && spill->contains(id); }
+  qint64 parentOf(qint64 id) const;
+  int childCountOf(qint64 id) const;
+  qint64 childOf(qint64 id, int row) const;
+  QVariant timestampData(qint64 timestamp) const;
+  QString formatTimestamp(qint64 timestamp) const;
+  void timestampsChanged();
+
   int _maxLines;
-  QStringList names;
-  QHash<QString, LogLine*> roots;
+  qint64 _maxBytes;
+  LogStore store;
+  LogSpill* spill;
+  QString _spillError;
+  LogIndex* textIndex;
+  int fetchedTopLevel;
+  // Only parents that have been paged past their first page have an entry
+  QHash<qint64, int> fetchedChildren;
   QFont _logFont;
+  bool _localTime, _showMilliseconds;
 
-  int find(const LogLine* parent, const LogLine* child) const;
-  QModelIndex index(LogLine* line, int column) const;
-  LogLine* lineForIndex(const QModelIndex& parent) const;
+  // Formatted seconds, indexed by the low bits of the second. Enough to cover
+  // the rows on screen, which tend to share seconds with their neighbours.
+  enum { TimeCacheSize = 64 };
+  struct CachedTime {
+    qint64 second;
+    QString text;
+  };
+  mutable CachedTime timeCache[TimeCacheSize];
 };
 
 #endif
@@ -0,0 +1,89 @@
+#include <QtTest>
+#include "logparser.h"
+#include "oldstripcolor.h"
+
+// Compares stripColor() with the QString::replace() version it replaced.
+// Both include the UTF-8 decoding that each needs to produce a QString: the
+// old version decoded first and the new one decodes its output.
+class BenchLogParser : public QObject
+{
+Q_OBJECT
+private slots:
+  void replace_data();
+  void replace();
+  void scan_data();
+  void scan();
+};
+
+// 1000 lines of each kind
+static QList<QByteArray> fixture(int kind)
+{
+  QList<QByteArray> lines;
+  for (int i = 0; i < 1000; i++) {
+    QByteArray line;
+    if (kind == 0) {
+      line = "2024-05-01 10:00:00,123 INFO  [worker-" + QByteArray::number(i % 16) + "] processed job " + QByteArray::number(i) + " without any color at all";
+    } else if (kind == 1) {
+      line = "\x1b[2m2024-05-01 10:00:00,123\x1b[0m \x1b[32mINFO\x1b[0m  [\x1b[36mworker-" + QByteArray::number(i % 16) + "\x1b[0m] processed job " + QByteArray::number(i);
+    } else if (kind == 2) {
+      // A color code on every word, as from a colorized pretty-printer
+      for (int word = 0; word < 40; word++) {
+        line += "\x1b[38;5;" + QByteArray::number(word * 7 % 256) + "mword" + QByteArray::number(word) + "\x1b[0m ";
+      }
+    } else {
+      // Long lines, with 400 color codes in 3.8 KB
+      for (int word = 0; word < 200; word++) {
+        line += "\x1b[1;3" + QByteArray::number(word % 8) + "mtoken" + QByteArray::number(i % 10) + "\x1b[0m, ";
+      }
+    }
+    lines << line;
+  }
+  return lines;
+}
+
+static void addFixtures()
+{
+  QTest::addColumn<QList<QByteArray>>("lines");
+  QTest::newRow("no color") << fixture(0);
+  QTest::newRow("colored log line") << fixture(1);
+  QTest::newRow("color on every word") << fixture(2);
+  QTest::newRow("long line") << fixture(3);
+}
+
+void BenchLogParser::replace_data()
+{
+  addFixtures();
+}
+
+void BenchLogParser::replace()
+{
+  QFETCH(QList<QByteArray>, lines);
+  QBENCHMARK {
+    for (const QByteArray& line : lines) {
+      QString message = oldStripColor(QString::fromUtf8(line));
+      Q_UNUSED(message);
+    }
+  }
+}
+
+void BenchLogParser::scan_data()
+{
+  addFixtures();
+}
+
+void BenchLogParser::scan()
+{
+  QFETCH(QList<QByteArray>, lines);
+  QByteArray buffer;
+  QBENCHMARK {
+    for (const QByteArray& line : lines) {
+      buffer.resize(line.size() * 5);
+      int length = stripColor(line.constData(), line.size(), buffer.data());
+      QString message = QString::fromUtf8(buffer.constData(), length);
+      Q_UNUSED(message);
+    }
+  }
+}
+
+QTEST_APPLESS_MAIN(BenchLogParser)
+#include "bench_logparser.moc"
@@ -0,0 +1,9 @@
+TEMPLATE = app
+TARGET = bench_logparser
+QT = core testlib
+MOC_DIR = .obj
+OBJECTS_DIR = .obj
+
+INCLUDEPATH += ../../src ../shared
+HEADERS += ../../src/logparser.h ../shared/oldstripcolor.h
+SOURCES += ../../src/logparser.cpp bench_logparser.cpp
@@ -0,0 +1,91 @@
+#include <QtTest>
+#include "logrules.h"
+#include "luavm.h"
+
+// Compares declarative rules with the Lua filter that does the same thing,
+// called the way DcLog calls it, over a million lines.
+class BenchLogRules : public QObject
+{
+Q_OBJECT
+private slots:
+  void initTestCase();
+  void equivalent();
+  void nativeRules();
+  void luaFilter();
+
+private:
+  LogRules rules;
+  LuaVM lua;
+  LuaFunction filter;
+  QStringList lines;
+};
+
+void BenchLogRules::initTestCase()
+{
+  rules.addRule(LogRules::Drop, LogRules::Literal, "GET /healthz");
+  rules.addRule(LogRules::Replace, LogRules::Regex, "^\\S+ ", "");
+  rules.addRule(LogRules::Drop, LogRules::Prefix, "DEBUG");
+  filter = lua.evaluate(
+    "return function(line)\n"
+    "  if line:find('GET /healthz', 1, true) then return nil end\n"
+    "  line = line:gsub('^%S+ ', '', 1)\n"
+    "  if line:sub(1, 5) == 'DEBUG' then return nil end\n"
+    "  return line\n"
+    "end\n").value<LuaFunction>();
+  QVERIFY(filter.isValid());
+
+  const char* levels[] = { "INFO", "DEBUG", "WARN", "ERROR" };
+  for (int i = 0; i < 1000000; i++) {
+    QString line = QString("2024-05-01T10:%1:%2.%3Z ").arg(i / 60000 % 60, 2, 10, QChar('0')).arg(i / 1000 % 60, 2, 10, QChar('0')).arg(i % 1000, 3, 10, QChar('0'));
+    if (i % 5 == 0) {
+      line += "INFO 10.0.0.7 GET /healthz 200 0.4ms";
+    } else {
+      line += QString("%1 worker-%2 processed job %3 in %4ms").arg(levels[i % 4]).arg(i % 16).arg(i).arg(i % 977);
+    }
+    lines << line;
+  }
+}
+
+void BenchLogRules::equivalent()
+{
+  for (int i = 0; i < 1000; i++) {
+    QString native = lines[i];
+    bool kept = rules.apply(&native);
+    QVariant filtered = LuaFunction::firstResult(filter({ lines[i] }));
+    QCOMPARE(kept, filtered.isValid());
+    if (kept) {
+      QCOMPARE(native, QString::fromUtf8(filtered.toByteArray()));
+    }
+  }
+}
+
+void BenchLogRules::nativeRules()
+{
+  int kept = 0;
+  QBENCHMARK_ONCE {
+    for (const QString& line : lines) {
+      QString message = line;
+      if (rules.apply(&message)) {
+        kept++;
+      }
+    }
+  }
+  QVERIFY(kept > 0);
+}
+
+void BenchLogRules::luaFilter()
+{
+  int kept = 0;
+  QBENCHMARK_ONCE {
+    for (const QString& line : lines) {
+      QVariant filtered = LuaFunction::firstResult(filter({ line }));
+      if (filtered.isValid()) {
+        kept++;
+      }
+    }
+  }
+  QVERIFY(kept > 0);
+}
+
+QTEST_GUILESS_MAIN(BenchLogRules)
+#include "bench_logrules.moc"
@@ -0,0 +1,13 @@
+TEMPLATE = app
+TARGET = bench_logrules
+QT = core testlib
+MOC_DIR = .obj
+OBJECTS_DIR = .obj
+
+CONFIG += link_pkgconfig
+PKGCONFIG += lua53-c++
+DEFINES += D_USE_LUA=1
+
+INCLUDEPATH += ../../src
+HEADERS += ../../src/logrules.h   ../../src/luavm.h   ../../src/luatable.h   ../../src/luafunction.h
+SOURCES += ../../src/logrules.cpp ../../src/luavm.cpp ../../src/luatable.cpp ../../src/luafunction.cpp bench_logrules.cpp
@@ -0,0 +1,181 @@
+#include <QtTest>
+#include <QDateTime>
+#include <memory>
+#include <vector>
+#include "logstore.h"
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// Compares LogStore with the per-line LogLine objects that TreeLogModel used
+// before it. The workload is 30 containers of 10k top-level lines of about 80
+// characters, with a 20-line stack trace nested under every 50th line.
+class BenchLogStore : public QObject
+{
+Q_OBJECT
+private slots:
+  void memory_data();
+  void memory();
+  void traversal_data();
+  void traversal();
+};
+
+enum { Containers = 30, TopLevelLines = 10000, TraceEvery = 50, TraceLines = 20 };
+
+// The old layout, as it was in TreeLogModel
+struct LogLine {
+  LogLine() : parent(nullptr), indent(0) {}
+  LogLine(LogLine* parent, const QDateTime& dt, const QString& msg) : datetime(dt), parent(parent), line(msg), indent(0) {}
+  LogLine(LogLine* parent, const QString& msg, int indent) : parent(parent), line(msg), indent(indent) {}
+  ~LogLine() { qDeleteAll(children); }
+
+  QDateTime datetime;
+  LogLine* parent;
+  QString line;
+  int indent;
+  std::vector<LogLine*> children;
+};
+
+// Calls add(timestamp, message, indent) for each line of one container. Every
+// message is built separately, so that no text is shared between lines.
+template <typename Add>
+static void generate(int container, Add add)
+{
+  qint64 timestamp = Q_INT64_C(1714557600000) + container;
+  for (int i = 0; i < TopLevelLines; i++) {
+    timestamp += 37;
+    add(timestamp, QString("INFO  [worker-%1] com.example.jobs.Runner - processed job %2 for tenant %3 in %4ms")
+        .arg(i % 16).arg(i).arg(container * 1000 + i % 97).arg(i % 977), 0);
+    if (i % TraceEvery == 0) {
+      for (int j = 0; j < TraceLines; j++) {
+        add(timestamp, QString("    at com.example.jobs.Step%1.run(Step%1.java:%2)").arg(j).arg(100 + i % 50), 4);
+      }
+    }
+  }
+}
+
+static std::vector<std::unique_ptr<LogLine>> buildLogLines()
+{
+  std::vector<std::unique_ptr<LogLine>> roots;
+  for (int c = 0; c < Containers; c++) {
+    LogLine* root = new LogLine();
+    generate(c, [root](qint64 timestamp, const QString& message, int indent) {
+      if (indent == 0) {
+        root->children.push_back(new LogLine(root, QDateTime::fromMSecsSinceEpoch(timestamp, Qt::UTC), message));
+      } else {
+        LogLine* parent = root->children.back();
+        parent->children.push_back(new LogLine(parent, message, indent));
+      }
+    });
+    roots.emplace_back(root);
+  }
+  return roots;
+}
+
+static std::vector<std::unique_ptr<LogStore>> buildLogStores()
+{
+  std::vector<std::unique_ptr<LogStore>> stores;
+  for (int c = 0; c < Containers; c++) {
+    LogStore* store = new LogStore();
+    generate(c, [store](qint64 timestamp, const QString& message, int indent) {
+      store->append(store->parentFor(indent), indent, timestamp, message);
+    });
+    stores.emplace_back(store);
+  }
+  return stores;
+}
+
+// Bytes currently allocated from the heap, or -1 if that can't be measured
+static qint64 heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  return qint64(mallinfo2().uordblks);
+#elif defined(__GLIBC__)
+  return quint32(mallinfo().uordblks);
+#else
+  return -1;
+#endif
+}
+
+void BenchLogStore::memory_data()
+{
+  QTest::addColumn<bool>("columnar");
+  QTest::newRow("LogLine") << false;
+  QTest::newRow("LogStore") << true;
+}
+
+void BenchLogStore::memory()
+{
+  QFETCH(bool, columnar);
+  qint64 before = heapInUse();
+  if (before < 0) {
+    QSKIP("Heap usage can only be measured with glibc");
+  }
+  qint64 used;
+  if (columnar) {
+    auto stores = buildLogStores();
+    used = heapInUse() - before;
+  } else {
+    auto roots = buildLogLines();
+    used = heapInUse() - before;
+  }
+  QTest::setBenchmarkResult(used, QTest::BytesAllocated);
+}
+
+void BenchLogStore::traversal_data()
+{
+  memory_data();
+}
+
+static qint64 visit(const LogLine* line)
+{
+  qint64 total = line->line.size() + (line->line.isEmpty() ? 0 : line->line[0].unicode());
+  for (const LogLine* child : line->children) {
+    total += visit(child);
+  }
+  return total;
+}
+
+static qint64 visit(const LogStore& store, qint64 id)
+{
+  int length;
+  const char* text = store.utf8(id, &length);
+  qint64 total = length + (length ? uchar(text[0]) : 0);
+  for (int row = 0, count = store.childCount(id); row < count; row++) {
+    total += visit(store, store.childId(id, row));
+  }
+  return total;
+}
+
+// Walks every line in tree order, reading its length and first character, as
+// a search or an export would
+void BenchLogStore::traversal()
+{
+  QFETCH(bool, columnar);
+  qint64 total = 0;
+  if (columnar) {
+    auto stores = buildLogStores();
+    QBENCHMARK {
+      total = 0;
+      for (const auto& store : stores) {
+        for (int row = 0; row < store->topLevelCount(); row++) {
+          total += visit(*store, store->topLevelId(row));
+        }
+      }
+    }
+  } else {
+    auto roots = buildLogLines();
+    QBENCHMARK {
+      total = 0;
+      for (const auto& root : roots) {
+        for (const LogLine* line : root->children) {
+          total += visit(line);
+        }
+      }
+    }
+  }
+  QVERIFY(total > 0);
+}
+
+QTEST_APPLESS_MAIN(BenchLogStore)
+#include "bench_logstore.moc"
@@ -0,0 +1,9 @@
+TEMPLATE = app
+TARGET = bench_logstore
+QT = core testlib
+MOC_DIR = .obj
+OBJECTS_DIR = .obj
+
+INCLUDEPATH += ../../src
+HEADERS += ../../src/logstore.h
+SOURCES += ../../src/logstore.cpp bench_logstore.cpp
@@ -0,0 +1,34 @@
+#ifndef D_OLDSTRIPCOLOR_H
+#define D_OLDSTRIPCOLOR_H
+
+#include <QString>
+
+// The QString::replace() based stripColor() that logparser.cpp replaced,
+// kept as the reference for its tests and benchmarks.
+inline QString oldStripColor(QString msg)
+{
+  int s = msg.length();
+  for (int i = 0; i < s - 2; i++) {
+    if (msg[i] != char(27) || msg[i + 1] != '[') {
+      continue;
+    }
+    for (int j = i + 2; j < s; j++) {
+      QChar ch = msg[j];
+      if (ch == 'm') {
+        msg.replace(i, j - i + 1, "");
+        i -= 1;
+        s = msg.length();
+        break;
+      } else if (!ch.isDigit() && ch != ';') {
+        msg.replace(i, 1, "<ESC>");
+        s += 4;
+        i += 4;
+        break;
+      }
+    }
+    continue;
+  }
+  return msg;
+}
+
+#endif
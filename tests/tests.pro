@@ -0,0 +1,9 @@
+TEMPLATE = subdirs
+
+SUBDIRS += tst_logindex tst_dockerlogstream tst_logparser tst_dclog
+
+# Benchmarks are built with the tests but not run by "make check"
+SUBDIRS += bench_logparser bench_logstore
+!isEmpty(USE_LUA) {
+  SUBDIRS += bench_logrules
+}
@@ -0,0 +1,104 @@
+#include <QtTest>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QtEndian>
+#include "dclog.h"
+#include "dcmonconfig.h"
+#include "dockerlogstream.h"
+
+// Runs DcLog against a fake Docker daemon, so that lines go through
+// DockerLogStream, the resume cursors and the rest of ingest together.
+class TestDcLog : public QObject
+{
+Q_OBJECT
+private slots:
+  void initTestCase();
+  void interleavedStreams();
+
+private:
+  static QByteArray frame(int stream, const QByteArray& data);
+  static QByteArray line(int second, const QByteArray& message);
+
+  QTemporaryDir dir;
+  QString socketPath;
+};
+
+void TestDcLog::initTestCase()
+{
+  QVERIFY(dir.isValid());
+  socketPath = dir.filePath("docker.sock");
+  qputenv("DOCKER_HOST", "unix://" + QFile::encodeName(socketPath));
+}
+
+QByteArray TestDcLog::frame(int stream, const QByteArray& data)
+{
+  uchar header[8] = { uchar(stream), 0, 0, 0 };
+  qToBigEndian<quint32>(data.size(), header + 4);
+  return QByteArray(reinterpret_cast<const char*>(header), 8) + data;
+}
+
+QByteArray TestDcLog::line(int second, const QByteArray& message)
+{
+  return "2024-05-01T10:00:" + QByteArray::number(second).rightJustified(2, '0') + ".000000000Z " + message + "\n";
+}
+
+// The daemon sends stdout and stderr frames in the order they were written,
+// but each read is split by stream before it reaches DcLog, so stderr lines
+// come in after newer stdout lines. None of them may be taken for lines that
+// were already seen, and a restart must not repeat any.
+void TestDcLog::interleavedStreams()
+{
+  QList<QByteArray> responses;
+  responses << frame(DockerLogStream::Stdout, line(1, "out 1")) + frame(DockerLogStream::Stderr, line(2, "err 2")) +
+               frame(DockerLogStream::Stdout, line(3, "out 3")) + frame(DockerLogStream::Stderr, line(4, "err 4")) +
+               frame(DockerLogStream::Stdout, line(5, "out 5")) + frame(DockerLogStream::Stderr, line(6, "err 6"));
+  // After the restart the daemon repeats the lines from the oldest cursor on
+  responses << frame(DockerLogStream::Stdout, line(5, "out 5")) + frame(DockerLogStream::Stderr, line(6, "err 6")) +
+               frame(DockerLogStream::Stdout, line(7, "out 7")) + frame(DockerLogStream::Stderr, line(8, "err 8"));
+
+  QLocalServer server;
+  QLocalServer::removeServer(socketPath);
+  QVERIFY2(server.listen(socketPath), qPrintable(server.errorString()));
+  QList<QByteArray> requests;
+  QObject::connect(&server, &QLocalServer::newConnection, [&] {
+    QLocalSocket* peer = server.nextPendingConnection();
+    QObject::connect(peer, &QLocalSocket::readyRead, [&, peer] {
+      QByteArray request = peer->readAll();
+      requests << request.left(request.indexOf("\r\n"));
+      // Without chunked encoding the body ends when the connection closes
+      peer->write("HTTP/1.1 200 OK\r\nContent-Type: application/vnd.docker.multiplexed-stream\r\n\r\n");
+      peer->write(responses.value(requests.size() - 1));
+      peer->disconnectFromServer();
+    });
+  });
+
+  DcmonConfig config;
+  DcLog log;
+  QStringList messages;
+  QObject::connect(&log, &DcLog::logBatch, [&](const LogBatch& entries) {
+    for (const LogEntry& entry : entries) {
+      QCOMPARE(entry.container, QString("web"));
+      QCOMPARE(entry.fromStderr, entry.message.startsWith("err"));
+      messages << entry.message;
+    }
+  });
+
+  log.setContainers(QStringList() << "web");
+  QTRY_COMPARE(messages.size(), 6);
+  messages.sort();
+  QCOMPARE(messages, QStringList({ "err 2", "err 4", "err 6", "out 1", "out 3", "out 5" }));
+  QVERIFY(requests[0].contains("tail="));
+
+  messages.clear();
+  log.statusChanged("web", "running");
+  QTRY_COMPARE(requests.size(), 2);
+  QVERIFY2(requests[1].contains("since=1714557605.000000000"), requests[1].constData());
+  QTRY_COMPARE(messages.size(), 2);
+  // Give any repeated lines the chance to show up
+  QTest::qWait(100);
+  messages.sort();
+  QCOMPARE(messages, QStringList({ "err 8", "out 7" }));
+}
+
+QTEST_GUILESS_MAIN(TestDcLog)
+#include "tst_dclog.moc"
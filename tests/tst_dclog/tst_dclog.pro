@@ -0,0 +1,10 @@
+TEMPLATE = app
+TARGET = tst_dclog
+QT = core gui widgets network testlib
+CONFIG += testcase
+MOC_DIR = .obj
+OBJECTS_DIR = .obj
+
+INCLUDEPATH += ../../src
+HEADERS += ../../src/dclog.h   ../../src/dcmonconfig.h   ../../src/dockerlogstream.h   ../../src/guiprofiler.h   ../../src/fileutil.h   ../../src/logparser.h   ../../src/logrules.h   ../../src/logentry.h
+SOURCES += ../../src/dclog.cpp ../../src/dcmonconfig.cpp ../../src/dockerlogstream.cpp ../../src/guiprofiler.cpp ../../src/fileutil.cpp ../../src/logparser.cpp ../../src/logrules.cpp tst_dclog.cpp
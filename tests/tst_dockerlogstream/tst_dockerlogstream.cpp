@@ -0,0 +1,146 @@
+#include <QtTest>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QtEndian>
+#include "dockerlogstream.h"
+
+// Points DockerLogStream at a fake daemon that replays a chunked, multiplexed
+// logs response a few bytes at a time, so that chunk sizes, frame headers and
+// lines are split across reads.
+class TestDockerLogStream : public QObject
+{
+Q_OBJECT
+private slots:
+  void initTestCase();
+  void replay_data();
+  void replay();
+
+private:
+  static QByteArray frame(int stream, const QByteArray& data);
+  static QByteArray chunked(const QByteArray& body, const QList<int>& splits);
+
+  QTemporaryDir dir;
+  QString socketPath;
+};
+
+void TestDockerLogStream::initTestCase()
+{
+  QVERIFY(dir.isValid());
+  socketPath = dir.filePath("docker.sock");
+  qputenv("DOCKER_HOST", "unix://" + QFile::encodeName(socketPath));
+  QCOMPARE(DockerLogStream::socketPath(), socketPath);
+}
+
+QByteArray TestDockerLogStream::frame(int stream, const QByteArray& data)
+{
+  uchar header[8] = { uchar(stream), 0, 0, 0 };
+  qToBigEndian<quint32>(data.size(), header + 4);
+  return QByteArray(reinterpret_cast<const char*>(header), 8) + data;
+}
+
+// Encodes the body as chunks that end at the given offsets
+QByteArray TestDockerLogStream::chunked(const QByteArray& body, const QList<int>& splits)
+{
+  QByteArray result;
+  int pos = 0;
+  for (int end : splits + QList<int>{ body.size() }) {
+    result += QByteArray::number(end - pos, 16) + "\r\n" + body.mid(pos, end - pos) + "\r\n";
+    pos = end;
+  }
+  return result + "0\r\n\r\n";
+}
+
+void TestDockerLogStream::replay_data()
+{
+  QTest::addColumn<QByteArray>("contentType");
+  QTest::addColumn<int>("pieceSize");
+
+  QTest::newRow("byte at a time") << QByteArray("application/vnd.docker.multiplexed-stream") << 1;
+  QTest::newRow("split headers") << QByteArray("application/vnd.docker.multiplexed-stream") << 5;
+  QTest::newRow("sniffed, byte at a time") << QByteArray("application/vnd.docker.raw-stream") << 1;
+  QTest::newRow("sniffed, split headers") << QByteArray("application/vnd.docker.raw-stream") << 3;
+  QTest::newRow("one write") << QByteArray("application/vnd.docker.multiplexed-stream") << (1 << 20);
+}
+
+void TestDockerLogStream::replay()
+{
+  QFETCH(QByteArray, contentType);
+  QFETCH(int, pieceSize);
+
+  QByteArray body;
+  QList<int> splits;
+  body += frame(DockerLogStream::Stdout, "2024-05-01T10:00:00.000000000Z one\n");
+  // A chunk that ends in the middle of the next frame header
+  splits << body.size() + 3;
+  body += frame(DockerLogStream::Stderr, "2024-05-01T10:00:01.000000000Z first error\n");
+  body += frame(DockerLogStream::Stdout, "2024-05-01T10:00:02.000000000Z two, in ");
+  splits << body.size() - 4;
+  body += frame(DockerLogStream::Stdout, "two frames\n2024-05-01T10:00:03.000000000Z three\n");
+  body += frame(DockerLogStream::Stderr, "2024-05-01T10:00:04.000000000Z second error\n");
+  splits << body.size();
+  // The last line has no newline and is flushed when the body ends
+  body += frame(DockerLogStream::Stdout, "2024-05-01T10:00:05.000000000Z last");
+
+  QByteArray response = "HTTP/1.1 200 OK\r\n"
+    "Content-Type: " + contentType + "\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "\r\n" + chunked(body, splits);
+
+  QLocalServer server;
+  QLocalServer::removeServer(socketPath);
+  QVERIFY2(server.listen(socketPath), qPrintable(server.errorString()));
+  QByteArray request;
+  QTimer replayer;
+  replayer.setInterval(1);
+  int sent = 0;
+  QLocalSocket* peer = nullptr;
+  QObject::connect(&server, &QLocalServer::newConnection, [&] {
+    peer = server.nextPendingConnection();
+    QObject::connect(peer, &QLocalSocket::readyRead, [&] {
+      request += peer->readAll();
+      if (request.contains("\r\n\r\n")) {
+        replayer.start();
+      }
+    });
+  });
+  // One piece per timer tick, so that the client reads each one separately
+  QObject::connect(&replayer, &QTimer::timeout, [&] {
+    peer->write(response.mid(sent, pieceSize));
+    peer->flush();
+    sent += pieceSize;
+    if (sent >= response.size()) {
+      replayer.stop();
+    }
+  });
+
+  DockerLogStream stream("web");
+  QByteArray output[3];
+  QStringList errors;
+  QObject::connect(&stream, &DockerLogStream::received, [&](const QString& container, int index, const QByteArray& lines) {
+    QCOMPARE(container, QString("web"));
+    QVERIFY(lines.endsWith('\n'));
+    output[index] += lines;
+  });
+  QObject::connect(&stream, &DockerLogStream::error, [&](const QString&, const QString& message) {
+    errors << message;
+  });
+  QSignalSpy finished(&stream, &DockerLogStream::finished);
+  stream.start("tail=10");
+  QVERIFY(finished.wait(10000));
+
+  QVERIFY(request.startsWith("GET /containers/web/logs?follow=1&stdout=1&stderr=1&timestamps=1&tail=10 HTTP/1.1\r\n"));
+  QCOMPARE(errors, QStringList());
+  QCOMPARE(output[DockerLogStream::Stdin], QByteArray());
+  QCOMPARE(output[DockerLogStream::Stdout], QByteArray(
+    "2024-05-01T10:00:00.000000000Z one\n"
+    "2024-05-01T10:00:02.000000000Z two, in two frames\n"
+    "2024-05-01T10:00:03.000000000Z three\n"
+    "2024-05-01T10:00:05.000000000Z last\n"));
+  QCOMPARE(output[DockerLogStream::Stderr], QByteArray(
+    "2024-05-01T10:00:01.000000000Z first error\n"
+    "2024-05-01T10:00:04.000000000Z second error\n"));
+  QVERIFY(!stream.isActive());
+}
+
+QTEST_GUILESS_MAIN(TestDockerLogStream)
+#include "tst_dockerlogstream.moc"
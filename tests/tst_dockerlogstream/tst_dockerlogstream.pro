@@ -0,0 +1,10 @@
+TEMPLATE = app
+TARGET = tst_dockerlogstream
+QT = core network testlib
+CONFIG += testcase
+MOC_DIR = .obj
+OBJECTS_DIR = .obj
+
+INCLUDEPATH += ../../src
+HEADERS += ../../src/dockerlogstream.h
+SOURCES += ../../src/dockerlogstream.cpp tst_dockerlogstream.cpp
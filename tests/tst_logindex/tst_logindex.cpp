@@ -0,0 +1,133 @@
+#include <QtTest>
+#include "logindex.h"
+
+// Checks the index against a full scan: every line that matches a query must
+// be among its candidates whenever the index narrows the search.
+class TestLogIndex : public QObject
+{
+Q_OBJECT
+private slots:
+  void initTestCase();
+  void requiredText_data();
+  void requiredText();
+  void candidates_data();
+  void candidates();
+
+private:
+  QList<QByteArray> lines;
+  LogIndex index;
+};
+
+void TestLogIndex::initTestCase()
+{
+  // Mostly filler, so that rare text stays under the index's cutoff for
+  // common text and the comparison isn't skipped
+  for (int i = 0; i < 5000; i++) {
+    lines << QByteArray("filler line ") + QByteArray::number(i) + " with nothing to find";
+  }
+  lines << "request ABC handled"
+        << "control \x01xyz char"
+        << "letter qabc here"
+        << "repeat foofoobar twice"
+        << "repeat abcabcxyz twice"
+        << "octal ABCD value"
+        << "took 12ms elapsed"
+        << "a word alone"
+        << "Connection Reset by peer"
+        << "temperature 300\xE2\x84\xAA reached";
+  for (int i = 0; i < lines.size(); i++) {
+    index.add(i * 2, lines[i].constData(), lines[i].size());
+  }
+}
+
+void TestLogIndex::requiredText_data()
+{
+  QTest::addColumn<QString>("query");
+  QTest::addColumn<QStringList>("required");
+
+  QTest::newRow("literal run") << "ms elapsed" << QStringList{ "ms elapsed" };
+  QTest::newRow("class escape") << "\\d+ms elapsed" << QStringList{ "ms elapsed" };
+  QTest::newRow("escaped punctuation") << "\\.?abc\\-def" << QStringList{ "abc-def" };
+  QTest::newRow("assertion") << "\\bword\\b" << QStringList{ "word" };
+  QTest::newRow("optional character") << "ab?cdef" << QStringList{ "a", "cdef" };
+  QTest::newRow("group") << "foo(bar)?baz" << QStringList{ "foo", "baz" };
+  QTest::newRow("alternative") << "abc|def" << QStringList();
+  QTest::newRow("inline option") << "(?i)abc" << QStringList();
+  QTest::newRow("hex escape") << "\\x41BC" << QStringList();
+  QTest::newRow("braced hex escape") << "\\x{41}BCD" << QStringList();
+  QTest::newRow("octal escape") << "\\101BC" << QStringList();
+  QTest::newRow("braced octal escape") << "\\o{101}BCD" << QStringList();
+  QTest::newRow("control escape") << "\\cAxyz" << QStringList();
+  QTest::newRow("backreference") << "(abc)\\1xyz" << QStringList();
+  QTest::newRow("relative backreference") << "(abc)\\g1xyz" << QStringList();
+  QTest::newRow("named backreference") << "(?<id>foo)\\k<id>bar" << QStringList();
+  QTest::newRow("property") << "\\pLabc" << QStringList();
+  QTest::newRow("braced property") << "\\p{L}abc" << QStringList();
+  QTest::newRow("named character") << "\\N{U+41}BC" << QStringList();
+}
+
+void TestLogIndex::requiredText()
+{
+  QFETCH(QString, query);
+  QFETCH(QStringList, required);
+  QStringList actual;
+  for (const QByteArray& text : LogIndex::requiredText(query, true)) {
+    actual << QString::fromUtf8(text);
+  }
+  QCOMPARE(actual, required);
+}
+
+void TestLogIndex::candidates_data()
+{
+  QTest::addColumn<QString>("query");
+  QTest::addColumn<bool>("regexp");
+  QTest::addColumn<bool>("caseSensitive");
+
+  QTest::newRow("literal") << "ABC handled" << false << true;
+  QTest::newRow("literal, any case") << "abc HANDLED" << false << false;
+  QTest::newRow("literal, Kelvin sign") << "300k reached" << false << false;
+  QTest::newRow("regexp") << "\\d+ms elapsed" << true << true;
+  QTest::newRow("regexp, any case") << "connection reset" << true << false;
+  QTest::newRow("hex escape") << "\\x41BC" << true << true;
+  QTest::newRow("braced hex escape") << "\\x{41}BCD" << true << true;
+  QTest::newRow("octal escape") << "\\101BC" << true << true;
+  QTest::newRow("braced octal escape") << "\\o{101}BCD" << true << true;
+  QTest::newRow("control escape") << "\\cAxyz" << true << true;
+  QTest::newRow("backreference") << "(abc)\\1xyz" << true << true;
+  QTest::newRow("relative backreference") << "(abc)\\g1xyz" << true << true;
+  QTest::newRow("named backreference") << "(?<id>foo)\\k<id>bar" << true << true;
+  QTest::newRow("property") << "\\pLabc" << true << true;
+  QTest::newRow("braced property") << "\\p{L}abc" << true << true;
+}
+
+void TestLogIndex::candidates()
+{
+  QFETCH(QString, query);
+  QFETCH(bool, regexp);
+  QFETCH(bool, caseSensitive);
+
+  QRegularExpression re(regexp ? query : QRegularExpression::escape(query));
+  if (caseSensitive) {
+    re.setPatternOptions(QRegularExpression::UseUnicodePropertiesOption);
+  } else {
+    re.setPatternOptions(QRegularExpression::UseUnicodePropertiesOption | QRegularExpression::CaseInsensitiveOption);
+  }
+  QVERIFY2(re.isValid(), qPrintable(re.errorString()));
+
+  QSet<qint64> ids;
+  bool narrowed = index.candidates(LogIndex::requiredText(query, regexp), caseSensitive, &ids);
+  int matches = 0;
+  for (int i = 0; i < lines.size(); i++) {
+    if (re.match(QString::fromUtf8(lines[i])).hasMatch()) {
+      matches++;
+      if (narrowed && !ids.contains(i * 2)) {
+        QFAIL(qPrintable(QString("\"%1\" was ruled out").arg(QString::fromUtf8(lines[i]))));
+      }
+    }
+  }
+  // Each query is meant to match one of the lines above
+  QVERIFY(matches > 0);
+}
+
+QTEST_APPLESS_MAIN(TestLogIndex)
+#include "tst_logindex.moc"
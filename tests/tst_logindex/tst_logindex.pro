@@ -0,0 +1,10 @@
+TEMPLATE = app
+TARGET = tst_logindex
+QT = core testlib
+CONFIG += testcase
+MOC_DIR = .obj
+OBJECTS_DIR = .obj
+
+INCLUDEPATH += ../../src
+HEADERS += ../../src/logindex.h
+SOURCES += ../../src/logindex.cpp tst_logindex.cpp
@@ -0,0 +1,130 @@
+#include <QtTest>
+#include "logparser.h"
+#include "oldstripcolor.h"
+
+// Checks stripColor() against the QString::replace() version it replaced,
+// with each of the escape scanners.
+class TestLogParser : public QObject
+{
+Q_OBJECT
+private slots:
+  void cleanupTestCase();
+  void stripColor_data();
+  void stripColor();
+  void stripColorBoundaries_data();
+  void stripColorBoundaries();
+  void stripColorFuzz_data();
+  void stripColorFuzz();
+
+private:
+  static QByteArray strip(const QByteArray& line);
+  static QByteArray reference(const QByteArray& line);
+};
+
+void TestLogParser::cleanupTestCase()
+{
+  // Back to the fastest scanner
+  setEscScanner(Avx2EscScanner) || setEscScanner(Sse2EscScanner) || setEscScanner(ScalarEscScanner);
+}
+
+QByteArray TestLogParser::strip(const QByteArray& line)
+{
+  QByteArray out(line.size() * 5, '\0');
+  out.truncate(::stripColor(line.constData(), line.size(), out.data()));
+  return out;
+}
+
+QByteArray TestLogParser::reference(const QByteArray& line)
+{
+  // Latin-1 keeps every byte as one character, so the old version sees the
+  // same positions as the new one
+  return oldStripColor(QString::fromLatin1(line)).toLatin1();
+}
+
+void TestLogParser::stripColor_data()
+{
+  QTest::addColumn<QByteArray>("line");
+  QTest::addColumn<QByteArray>("expected");
+
+  QTest::newRow("plain") << QByteArray("no color here") << QByteArray("no color here");
+  QTest::newRow("empty") << QByteArray() << QByteArray();
+  QTest::newRow("sgr") << QByteArray("\x1b[1;31mred\x1b[0m text") << QByteArray("red text");
+  QTest::newRow("bare sgr") << QByteArray("\x1b[mreset") << QByteArray("reset");
+  QTest::newRow("cursor movement") << QByteArray("up\x1b[2Aagain") << QByteArray("up<ESC>[2Aagain");
+  QTest::newRow("erase line") << QByteArray("\x1b[Kcleared") << QByteArray("<ESC>[Kcleared");
+  QTest::newRow("not csi") << QByteArray("\x1b(Bcharset") << QByteArray("\x1b(Bcharset");
+  QTest::newRow("unterminated") << QByteArray("end\x1b[31") << QByteArray("end\x1b[31");
+  QTest::newRow("escape at end") << QByteArray("end\x1b[") << QByteArray("end\x1b[");
+  QTest::newRow("lone escape") << QByteArray("end\x1b") << QByteArray("end\x1b");
+  QTest::newRow("adjacent") << QByteArray("\x1b[1m\x1b[32m\x1b[Jx") << QByteArray("<ESC>[Jx");
+  QTest::newRow("utf-8") << QByteArray("caf\xc3\xa9 \x1b[33m\xe2\x9c\x93\x1b[0m") << QByteArray("caf\xc3\xa9 \xe2\x9c\x93");
+}
+
+void TestLogParser::stripColor()
+{
+  QFETCH(QByteArray, line);
+  QFETCH(QByteArray, expected);
+  QCOMPARE(strip(line), expected);
+  QCOMPARE(reference(line), expected);
+}
+
+void TestLogParser::stripColorBoundaries_data()
+{
+  QTest::addColumn<int>("scanner");
+  QTest::newRow("scalar") << int(ScalarEscScanner);
+  QTest::newRow("sse2") << int(Sse2EscScanner);
+  QTest::newRow("avx2") << int(Avx2EscScanner);
+}
+
+// Puts each kind of sequence at every offset around the 16- and 32-byte
+// blocks that the vector scanners read, including sequences cut off by the
+// end of the line.
+void TestLogParser::stripColorBoundaries()
+{
+  QFETCH(int, scanner);
+  if (!setEscScanner(EscScanner(scanner))) {
+    QSKIP("Not supported by this CPU");
+  }
+  QList<QByteArray> sequences{ "\x1b[0m", "\x1b[38;5;208m", "\x1b[2K", "\x1b]0;title", "\x1b[", "\x1b" };
+  for (const QByteArray& sequence : sequences) {
+    for (int offset = 0; offset < 100; offset++) {
+      for (int tail : { 0, 1, 2, 15, 16, 17, 31, 32, 33 }) {
+        QByteArray line = QByteArray(offset, 'a') + sequence + QByteArray(tail, 'z');
+        if (strip(line) != reference(line)) {
+          QFAIL(qPrintable(QString("offset %1, tail %2: %3").arg(offset).arg(tail).arg(QString::fromLatin1(line.toPercentEncoding()))));
+        }
+      }
+    }
+  }
+}
+
+void TestLogParser::stripColorFuzz_data()
+{
+  stripColorBoundaries_data();
+}
+
+// Random lines made mostly of the bytes that matter to the parser
+void TestLogParser::stripColorFuzz()
+{
+  QFETCH(int, scanner);
+  if (!setEscScanner(EscScanner(scanner))) {
+    QSKIP("Not supported by this CPU");
+  }
+  const char alphabet[] = "\x1b\x1b\x1b[[[;;0123456789mmKAx \xe9";
+  quint32 seed = 12345;
+  for (int i = 0; i < 20000; i++) {
+    QByteArray line;
+    seed = seed * 1103515245 + 12345;
+    int length = (seed >> 16) % 200;
+    for (int j = 0; j < length; j++) {
+      seed = seed * 1103515245 + 12345;
+      line += alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+    }
+    if (strip(line) != reference(line)) {
+      QFAIL(qPrintable(QString::fromLatin1(line.toPercentEncoding())));
+    }
+  }
+}
+
+QTEST_APPLESS_MAIN(TestLogParser)
+#include "tst_logparser.moc"
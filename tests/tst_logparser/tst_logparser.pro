@@ -0,0 +1,10 @@
+TEMPLATE = app
+TARGET = tst_logparser
+QT = core testlib
+CONFIG += testcase
+MOC_DIR = .obj
+OBJECTS_DIR = .obj
+
+INCLUDEPATH += ../../src ../shared
+HEADERS += ../../src/logparser.h ../shared/oldstripcolor.h
+SOURCES += ../../src/logparser.cpp tst_logparser.cpp